@@ -0,0 +1,46 @@
+#ifndef CHESSENGINE_BATCH_H
+#define CHESSENGINE_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "search.h"
+
+enum class BatchFormat {
+  JSONL,
+  CSV,
+};
+
+struct BatchOptions {
+  int threads = 1;
+  // Limits for positions that do not specify their own.
+  int depth = 6;
+  uint64_t nodes = 0;
+  // Size of the hash table of each worker.
+  size_t hash_megabytes = 4;
+  BatchFormat format = BatchFormat::JSONL;
+  // Maximum number of positions read ahead of the oldest unwritten result,
+  // which bounds memory use regardless of the input size. Defaults to four
+  // per thread if 0.
+  size_t window = 0;
+};
+
+// Analyses a stream of positions, one per line, in parallel. Each line holds
+// a FEN optionally followed by limits for that position only, separated by
+// semicolons, e.g. "<FEN>; depth 8" or "<FEN>; nodes 100000". Empty lines
+// and lines starting with '#' are skipped. Writes the score, best move,
+// depth, nodes and time of each position to `output` as soon as all
+// preceding positions are done, so that results are in input order.
+// Returns the number of positions analysed.
+uint64_t AnalyseBatch(std::istream& input, std::ostream& output, const BatchOptions& options);
+
+// Splits a line of input to AnalyseBatch() into the FEN and its limits,
+// using the defaults of `options`. Returns false if the line holds no
+// position.
+bool ParseBatchLine(const std::string& line, const BatchOptions& options,
+                    std::string& fen, SearchLimits& limits);
+
+#endif
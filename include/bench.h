@@ -0,0 +1,39 @@
+#ifndef CHESSENGINE_BENCH_H
+#define CHESSENGINE_BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+struct BenchOptions {
+  int depth = 3;
+  int threads = 1;
+  size_t hash_megabytes = 16;
+  // If set, receives the search statistics of each position as a line of
+  // JSON.
+  std::ostream* stats_output = nullptr;
+};
+
+struct BenchResult {
+  // Nodes searched over all positions. With one thread, a signature of
+  // the search: any change to it is a change in behaviour.
+  uint64_t nodes = 0;
+  double seconds = 0;
+  size_t positions = 0;
+
+  uint64_t NodesPerSecond() const {
+    return static_cast<uint64_t>(this->nodes / (this->seconds > 0 ? this->seconds : 1e-9));
+  }
+};
+
+// Called after each position with its FEN and the nodes searched.
+using BenchProgress = std::function<void(const std::string& fen, uint64_t nodes)>;
+
+// Searches a fixed set of about 50 positions to a fixed depth, each from
+// an empty hash table. Single-threaded runs are deterministic, as long as
+// the same bitbases are loaded.
+BenchResult RunBench(const BenchOptions& options, const BenchProgress& progress = nullptr);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef CHESSENGINE_BITBASE_H
+#define CHESSENGINE_BITBASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "board.h"
+#include "pieces.h"
+
+// Files of bitbases start with this 8-byte magic, followed by one bit per
+// position index, set if the strong side wins, least significant bit
+// first.
+constexpr char kBitbaseMagic[8] = {'C', 'E', 'B', 'B', 'A', 'S', 'E', '1'};
+
+// Score of a won bitbase position, before the bonus for making progress.
+// Above any material balance, below mate.
+constexpr int kBitbaseWin = 10000;
+
+// An endgame of a king and one or two pieces against a bare king.
+struct BitbaseMaterial {
+  // Also the file name of the bitbase, without the ".bb" extension.
+  const char* name;
+  int num_pieces;
+  // Piece types of the strong side besides the king, without color.
+  Piece pieces[2];
+};
+
+constexpr BitbaseMaterial kBitbaseMaterials[] = {
+  {"KPK", 1, {Piece::PAWN, Piece::EMPTY}},
+  {"KRK", 1, {Piece::ROOK, Piece::EMPTY}},
+  {"KQK", 1, {Piece::QUEEN, Piece::EMPTY}},
+  {"KBNK", 2, {Piece::BISHOP, Piece::KNIGHT}},
+};
+constexpr size_t kNumBitbases = sizeof(kBitbaseMaterials) / sizeof(kBitbaseMaterials[0]);
+
+// Number of position indices of a bitbase.
+constexpr uint64_t BitbasePositions(const BitbaseMaterial& material) {
+  return uint64_t{2} << (12 + 6 * material.num_pieces);
+}
+
+// Returns the index of a position. Squares are numbered `rank * 8 + file`,
+// with the strong side playing white; positions where black is strong are
+// mirrored. `pieces` holds the squares of the pieces of `material`, in
+// order.
+inline uint64_t BitbaseIndex(const BitbaseMaterial& material, bool strong_to_move,
+                             int strong_king, int weak_king, const int* pieces) {
+  uint64_t index = ((strong_to_move ? 0 : 1) * 64 + strong_king) * 64 + weak_king;
+  for (int i = 0; i < material.num_pieces; i++) {
+    index = index * 64 + pieces[i];
+  }
+  return index;
+}
+
+// Maps the bitbase files found in `directory`, replacing bitbases loaded
+// before, and returns the number found. Must not be called while searching.
+size_t LoadBitbases(const std::string& directory);
+
+// Returns the score of a position with at most four pieces, from white's
+// point of view, if it is known: 0 for draws by insufficient material and
+// for draws in a loaded bitbase, and kBitbaseWin plus a bonus for wins, so
+// that the search still drives the weak king to the edge and the pawn
+// forward.
+std::optional<int> ProbeBitbases(const Board& board);
+
+#endif
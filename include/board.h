@@ -1,9 +1,11 @@
 #ifndef CHESSENGINE_BOARD_H
 #define CHESSENGINE_BOARD_H
 
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 
 #include "pieces.h"
 
@@ -23,6 +25,31 @@ constexpr enum Castling operator ~(const enum Castling v) {
   return static_cast<Castling>(~static_cast<uint8_t>(v));
 }
 
+// Reasons for rejecting a FEN string.
+enum class FenError : uint8_t {
+  OK = 0,
+  BAD_PLACEMENT,
+  // Each side must have exactly one king.
+  MISSING_KING,
+  BAD_SIDE_TO_MOVE,
+  BAD_CASTLING,
+  BAD_EN_PASSANT,
+  BAD_CLOCK,
+  TRAILING_CHARACTERS,
+};
+
+const char* FenErrorMessage(FenError error);
+
+// Longest FEN written by Board::ToFEN(), including the terminating null.
+constexpr size_t kMaxFENLength = 128;
+
+// Fixed-size binary encoding of a position, see Board::Pack() for the
+// layout. Plain bytes, so that files of packed positions are portable and
+// can be used in place when mapped into memory.
+struct PackedBoard {
+  uint8_t bytes[32];
+};
+
 struct SquareIndex {
   int8_t file;
   int8_t rank;
@@ -41,14 +68,49 @@ class Board {
 
   void Move(SquareIndex from, SquareIndex to, Piece promotion, Castling castling);
 
+  // Forgets the en passant square, e.g. when no pawn can capture on it.
+  inline void ClearEnPassant() {
+    this->en_passent.reset();
+  }
+
   // Returns the next unoccupied square after 
   std::optional<SquareIndex> NextOccupied(
     SquareIndex square, bool white) const;
 
-  // Set up a position from a FEN notation string.
+  // Returns a bitmask with bit `rank * 8 + file` set for every square
+  // occupied by a piece of the given color.
+  uint64_t Occupancy(bool white) const;
+
+  // Returns a Zobrist hash of the position, covering piece placement, side
+  // to move, castling rights and the en passant square.
+  uint64_t Hash() const;
+
+  // Set up a position from a FEN notation string. Throws
+  // std::invalid_argument if the string is malformed.
   static Board FromFEN(const std::string& fen);
+  // Set up a position from a FEN notation string, without allocating. The
+  // move clocks may be left out. On error, `board` is left in an
+  // unspecified state.
+  static FenError ParseFEN(std::string_view fen, Board& board);
   // Write the current position to FEN notation.
   std::string ToFEN() const;
+  // Writes the current position to FEN notation in `buffer`, which must
+  // hold kMaxFENLength characters, and returns its length without the
+  // terminating null.
+  size_t ToFEN(char* buffer) const;
+
+  // Encodes the position in 32 bytes: the occupancy bitmask as 8 bytes
+  // little endian, a 4-bit code for each piece in square order, two per
+  // byte starting with the low nibble, then the side to move and castling
+  // rights, the en passant file, the halfmove clock and the fullmove number
+  // as 2 bytes little endian. Clocks beyond the range are clamped. Throws
+  // std::invalid_argument if there are more than 32 pieces, see CanPack().
+  PackedBoard Pack() const;
+  // Returns true if the position has at most 32 pieces, as Pack() requires.
+  bool CanPack() const;
+  // Decodes a packed position. Returns false if it is malformed, in which
+  // case `board` is left in an unspecified state.
+  static bool Unpack(const PackedBoard& packed, Board& board);
 
   // Prints the game board to e.g. std::cout.
   void Print(std::ostream& stream) const;
@@ -56,6 +118,10 @@ class Board {
   inline Piece Get(int8_t file, int8_t rank) const {
     return this->squares[rank][file];
   }
+  // Returns all 64 squares as a flat array indexed by `rank * 8 + file`.
+  inline const Piece* Squares() const {
+    return &this->squares[0][0];
+  }
   inline bool WhiteToMove() const {
     return this->white_to_move;
   }
@@ -79,6 +145,13 @@ class Board {
   }
 
  private:
+  // Locates the rooks that castling rights refer to.
+  void FindRookStartFiles();
+  // Returns true if every side with castling rights has its king on its
+  // back rank and an own rook on the start file on the side of each right.
+  // Call after FindRookStartFiles().
+  bool HasCastlingRooks() const;
+
   Piece squares[8][8];
   Castling castling[2];
   SquareIndex kings_position[2];
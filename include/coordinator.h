@@ -0,0 +1,50 @@
+#ifndef CHESSENGINE_COORDINATOR_H
+#define CHESSENGINE_COORDINATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "search.h"
+
+// Distributes analysis over worker processes, which are analysis servers
+// (see server.h) on this or other machines. Every task is sent as a fresh
+// request with the size of its table, so its result does not depend on the
+// worker it ran on, and results are merged in a fixed order: the output is
+// the same for any number, speed or failure of workers.
+struct CoordinatorOptions {
+  // Worker addresses, see socket.h.
+  std::vector<std::string> workers;
+  // Connections opened to each worker, i.e. the number of tasks each runs
+  // at a time. Should match the number of threads of the workers.
+  int connections = 1;
+  // Time in milliseconds after which an unanswered task is taken from its
+  // worker, which is then reconnected.
+  int64_t task_timeout = 60000;
+  // Failed connection attempts after which a connection is given up.
+  int max_retries = 3;
+  // Limits for positions that do not specify their own.
+  int depth = 6;
+  uint64_t nodes = 0;
+  // Size of the table every task is searched with, on any worker.
+  size_t hash_megabytes = 16;
+  // Receives a line for every completed task, if set.
+  std::ostream* log = nullptr;
+};
+
+// Analyses a list of positions, in the input format of AnalyseBatch(), and
+// writes one JSON object per position to `output`, in input order. Returns
+// the number of positions. Throws std::runtime_error if all workers fail.
+uint64_t CoordinateBatch(std::istream& input, std::ostream& output,
+                         const CoordinatorOptions& options);
+
+// Searches the position `depth` plies deep by searching the position after
+// each root move `depth` - 1 plies deep on the workers, or locally if
+// `depth` is 1. Ties between moves are broken by move generation order. Throws std::runtime_error if all workers fail.
+SearchResult CoordinateSearch(const Board& board, int depth, const CoordinatorOptions& options);
+
+#endif
@@ -1,11 +1,21 @@
 #ifndef CHESSENGINE_EVALUATION_H
 #define CHESSENGINE_EVALUATION_H
 
+#include <cstdint>
+
 #include "board.h"
 
+// Returns the material balance of the position, without searching.
+// Positive values indicate advantage for white.
+int CountPieces(const Board* board);
+
 // Returns a heuristic score for the value of the current position.
 // Positive values indicate advantage for white, negative for black.
 // Return value is in units of 1 / 100th pawn.
 int Evaluate(const Board* board, int depth);
 
+// Returns a hash of the evaluation parameters, which changes whenever they
+// are retuned, e.g. to reject scores saved by another version.
+uint64_t EvaluationFingerprint();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,13 @@
+// Evaluation parameters. Hand-picked; `tune` regenerates this file from
+// labelled training positions, see tools/tune.cc.
+
+#ifndef CHESSENGINE_EVALUATION_PARAMS_H
+#define CHESSENGINE_EVALUATION_PARAMS_H
+
+constexpr int kPawn = 100;
+constexpr int kKnight = 300;
+constexpr int kBishop = 300;
+constexpr int kRook = 500;
+constexpr int kQueen = 800;
+
+#endif
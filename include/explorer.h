@@ -0,0 +1,95 @@
+#ifndef CHESSENGINE_EXPLORER_H
+#define CHESSENGINE_EXPLORER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "mapped_file.h"
+#include "moves.h"
+#include "pgn.h"
+
+// Files of explorer statistics start with this 8-byte magic and the number
+// of records as a little endian 64-bit integer, followed by the records in
+// the byte order of the machine, sorted by key and move.
+constexpr char kExplorerFileMagic[8] = {'C', 'E', 'E', 'X', 'P', 'L', '0', '1'};
+
+// Statistics of one move played in one position.
+struct ExplorerRecord {
+  // Board::Hash() of the position, without an en passant square that no
+  // pawn can capture on.
+  uint64_t key;
+  // The move, see PackMove().
+  uint32_t move;
+  uint32_t white_wins;
+  uint32_t draws;
+  uint32_t black_wins;
+};
+static_assert(sizeof(ExplorerRecord) == 24, "explorer records are stored as they are");
+
+struct ExplorerMove {
+  Move move;
+  uint64_t white_wins = 0;
+  uint64_t draws = 0;
+  uint64_t black_wins = 0;
+
+  uint64_t Games() const {
+    return this->white_wins + this->draws + this->black_wins;
+  }
+};
+
+struct ExplorerBuildOptions {
+  PgnOptions pgn;
+  // Plies of each game counted, from its start.
+  int max_plies = 40;
+  // Records aggregated in memory before they are sorted and written to a
+  // temporary run file, 24 bytes each. Runs are merged at the end, so the
+  // index may be far larger than memory.
+  size_t run_records = 1 << 24;
+};
+
+struct ExplorerBuildStats {
+  PgnStats games;
+  // Distinct position and move pairs written.
+  uint64_t records = 0;
+  // Run files merged.
+  size_t runs = 0;
+};
+
+// Replays the games of a PGN database and writes the statistics of every
+// move played in the first plies of a game with a decisive or drawn
+// result to a new index file at `path`. Throws std::runtime_error if a
+// file cannot be written.
+ExplorerBuildStats BuildExplorer(std::istream& games, const std::string& path,
+                                 const ExplorerBuildOptions& options,
+                                 const PgnProgress& progress = nullptr);
+
+// Looks up positions in an index written by BuildExplorer(). The file is
+// mapped into memory and searched in place, so opening it costs nothing
+// and a lookup touches only a few pages.
+class OpeningExplorer {
+ public:
+  // Throws std::runtime_error if the file cannot be read or is not an
+  // explorer index.
+  explicit OpeningExplorer(const std::string& path);
+
+  size_t Count() const {
+    return this->count;
+  }
+
+  // Returns the moves played in the position, most often played first.
+  std::vector<ExplorerMove> Lookup(const Board& board) const;
+
+ private:
+  // Index of the first record with `key`, or of the first greater one.
+  size_t LowerBound(uint64_t key) const;
+
+  MappedFile file;
+  const ExplorerRecord* records;
+  size_t count;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CHESSENGINE_FEN_H
+#define CHESSENGINE_FEN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+
+// Calls `visit` with every non-empty line of `text`, without its line
+// ending and trailing spaces.
+template <typename Visitor>
+void ForEachLine(std::string_view text, Visitor&& visit) {
+  while (!text.empty()) {
+    const char* newline = static_cast<const char*>(memchr(text.data(), '\n', text.size()));
+    const size_t length = newline == nullptr ? text.size() : newline - text.data();
+    std::string_view line = text.substr(0, length);
+    text.remove_prefix(std::min(length + 1, text.size()));
+
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+      line.remove_suffix(1);
+    }
+    if (!line.empty()) {
+      visit(line);
+    }
+  }
+}
+
+// Parses newline separated FEN strings and appends the positions to
+// `boards`. Empty lines are skipped, as are lines that fail to parse, which
+// are counted in the return value.
+size_t ParseFENLines(std::string_view text, std::vector<Board>& boards);
+
+// Parses a file of newline separated FEN strings, mapped into memory, and
+// appends the positions to `boards`. Returns the number of malformed lines.
+// Throws std::runtime_error if the file cannot be read.
+size_t LoadFENFile(const std::string& path, std::vector<Board>& boards);
+
+#endif
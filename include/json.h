@@ -0,0 +1,18 @@
+#ifndef CHESSENGINE_JSON_H
+#define CHESSENGINE_JSON_H
+
+#include <map>
+#include <string>
+
+// Members of a JSON object without nested objects or arrays. String values
+// are stored unescaped; numbers, booleans and null are stored as written.
+using JsonObject = std::map<std::string, std::string>;
+
+// Escapes a string for use inside a JSON string literal.
+std::string JsonEscape(const std::string& text);
+
+// Parses a single flat JSON object, as used by the line-delimited protocols.
+// Returns false if the text is not such an object.
+bool ParseJsonObject(const std::string& text, JsonObject& object);
+
+#endif
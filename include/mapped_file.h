@@ -0,0 +1,39 @@
+#ifndef CHESSENGINE_MAPPED_FILE_H
+#define CHESSENGINE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file, so that large data files are
+// paged in by the kernel on demand instead of being read into buffers.
+class MappedFile {
+ public:
+  // Maps the file at `path`. Throws std::runtime_error if it cannot be
+  // opened or mapped.
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other);
+  MappedFile& operator=(MappedFile&& other);
+
+  const char* Data() const {
+    return this->data;
+  }
+  size_t Size() const {
+    return this->size;
+  }
+  std::string_view View() const {
+    return std::string_view(this->data, this->size);
+  }
+
+ private:
+  void Unmap();
+
+  const char* data = nullptr;
+  size_t size = 0;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef CHESSENGINE_MATCH_H
+#define CHESSENGINE_MATCH_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "moves.h"
+#include "search.h"
+#include "socket.h"
+
+// Limits of the moves of a game. At least one must be set.
+struct TimeControl {
+  // Clock time of each side at the start of the game, and added after each
+  // of its moves, in milliseconds. No clock if `base` is 0.
+  int64_t base = 0;
+  int64_t increment = 0;
+  // Limits of every search, unless 0.
+  int depth = 0;
+  uint64_t nodes = 0;
+};
+
+struct PlayerMove {
+  // Nullopt if the player failed to answer.
+  std::optional<Move> move;
+  // Score reported for the move, from white's point of view.
+  std::optional<int> score;
+};
+
+// A participant of games, keeping its state between the moves of a game.
+class Player {
+ public:
+  virtual ~Player() = default;
+
+  virtual void NewGame() = 0;
+  // Returns the move to play in `position`, reached by `moves` from
+  // `start`, with `time_left` on the clocks of white and black.
+  virtual PlayerMove Play(const Board& start,
+                          const std::vector<Move>& moves,
+                          const Board& position,
+                          const TimeControl& control,
+                          const std::array<int64_t, 2>& time_left) = 0;
+};
+
+// Plays with a search of this process.
+class SearchPlayer : public Player {
+ public:
+  SearchPlayer(size_t hash_megabytes, int threads);
+
+  void NewGame() override;
+  PlayerMove Play(const Board& start,
+                  const std::vector<Move>& moves,
+                  const Board& position,
+                  const TimeControl& control,
+                  const std::array<int64_t, 2>& time_left) override;
+
+ private:
+  Search search;
+  int threads;
+};
+
+// Plays with a UCI engine, run as a child process that talks over a socket
+// pair. Callers should ignore SIGPIPE, so that an engine exiting early
+// makes it lose its game instead of ending this process.
+class UciPlayer : public Player {
+ public:
+  // Starts `command`, e.g. {"./engine", "uci"}, sets the options, given as
+  // name and value pairs, and waits until the engine is ready. Throws
+  // std::runtime_error if the engine cannot be started or does not answer.
+  UciPlayer(const std::vector<std::string>& command,
+            const std::vector<std::pair<std::string, std::string>>& options);
+  // Asks the engine to quit, and kills it if it does not.
+  ~UciPlayer() override;
+
+  UciPlayer(const UciPlayer&) = delete;
+  UciPlayer& operator=(const UciPlayer&) = delete;
+
+  void NewGame() override;
+  PlayerMove Play(const Board& start,
+                  const std::vector<Move>& moves,
+                  const Board& position,
+                  const TimeControl& control,
+                  const std::array<int64_t, 2>& time_left) override;
+
+ private:
+  void Send(const std::string& line);
+  // Reads lines until one starts with `prefix`. Returns false if the
+  // engine exits or the deadline passes first.
+  bool WaitFor(const std::string& prefix, std::chrono::steady_clock::time_point deadline);
+
+  std::string command;
+  pid_t pid = -1;
+  int fd = -1;
+  LineReader reader;
+};
+
+enum class GameResult : uint8_t {
+  WHITE_WINS,
+  DRAW,
+  BLACK_WINS,
+};
+
+// Returns "1-0", "1/2-1/2" or "0-1".
+const char* GameResultString(GameResult result);
+
+// Ends games early once their result is clear. Scores are those reported
+// by the players with their moves.
+struct Adjudication {
+  // A side wins once both players' scores are at least this much in its
+  // favour for `resign_moves` moves each. Disabled if 0.
+  int resign_score = 1000;
+  int resign_moves = 3;
+  // The game is drawn after `draw_ply` plies, once both players' scores
+  // stay within `draw_score` of 0 for `draw_moves` moves each. Disabled if
+  // `draw_moves` is 0.
+  int draw_ply = 80;
+  int draw_score = 10;
+  int draw_moves = 8;
+  // Scores positions found in the loaded endgame bitbases.
+  bool bitbases = true;
+  // Games reaching this many plies are drawn.
+  int max_plies = 400;
+};
+
+struct GameRecord {
+  Board start;
+  std::vector<Move> moves;
+  // Scores reported with each move.
+  std::vector<std::optional<int>> scores;
+  GameResult result = GameResult::DRAW;
+  // How the game ended, e.g. "checkmate" or "adjudication".
+  std::string termination;
+};
+
+// Plays a game from `start` to its end by the rules, a time forfeit or
+// adjudication. A player that fails to answer, or answers with an illegal
+// move, loses.
+GameRecord PlayGame(const Board& start, Player& white, Player& black,
+                    const TimeControl& control, const Adjudication& adjudication);
+
+// Returns the Elo difference at which a player is expected to score
+// `score`, between 0 and 1, against its opponent.
+double EloFromScore(double score);
+
+// Sequential probability ratio test of the hypothesis that a player is
+// `elo1` stronger than its opponent, against the hypothesis that it is
+// only `elo0` stronger, with the given error rates. Results are taken to
+// be normally distributed, which is accurate after a few dozen games.
+struct Sprt {
+  double elo0 = 0;
+  double elo1 = 5;
+  double alpha = 0.05;
+  double beta = 0.05;
+
+  // Log-likelihood ratio of the results. Accept H1 once it reaches the
+  // upper bound, and H0 once it reaches the lower bound.
+  double LogLikelihoodRatio(uint64_t wins, uint64_t draws, uint64_t losses) const;
+  double LowerBound() const;
+  double UpperBound() const;
+};
+
+#endif
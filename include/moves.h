@@ -1,6 +1,9 @@
 #ifndef CHESSENGINE_MOVES_H
 #define CHESSENGINE_MOVES_H
 
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "board.h"
@@ -13,11 +16,47 @@ struct Move {
 	Piece promotion = Piece::EMPTY;
 };
 
+inline bool operator==(const Move& lhs, const Move& rhs) {
+	return (
+		lhs.from.file == rhs.from.file && lhs.from.rank == rhs.from.rank &&
+		lhs.to.file == rhs.to.file && lhs.to.rank == rhs.to.rank &&
+		lhs.castling == rhs.castling && lhs.promotion == rhs.promotion
+	);
+}
+inline bool operator!=(const Move& lhs, const Move& rhs) {
+	return !(lhs == rhs);
+}
+
+// Writes the move in coordinate notation, e.g. "e2e4" or "e7e8q". Castling
+// is written as the move of the king.
+std::string MoveToString(const Move& move);
+// Returns the legal move written in coordinate notation as `text` in the
+// position, or nullopt if there is no such move.
+std::optional<Move> MoveFromString(const Board& board, const std::string& text);
+// Returns the legal move written in standard algebraic notation as `san` in
+// the position, e.g. "Nbd7", "exd5", "e8=Q+" or "O-O", or nullopt if there
+// is no such move or it is ambiguous.
+std::optional<Move> MoveFromSAN(const Board& board, std::string_view san);
+
+// Packs a move into the lowest 18 bits of an integer, e.g. for storing it
+// in a hash table entry.
+uint32_t PackMove(const Move& move);
+// Restores a move packed with `PackMove`.
+Move UnpackMove(uint32_t packed);
+
+// Returns true if `move` is a legal move in the position. Used to verify
+// moves from other sources than the move generator, e.g. the hash table.
+bool IsLegal(const Board& board, const Move& move);
+
 // Returns true if the square at `square` is attacked by any white piece
 // if `by_white` is true, otherwise by black.
 bool IsAttacked(
 	const Board& board, SquareIndex square, bool by_white);
 
+// Returns the number of legal moves in the position. Faster than iterating
+// the moves, as only moves that may expose the king are played out.
+int CountLegalMoves(const Board& board);
+
 // Creates an iterator over all legal moves in the current position.
 class MoveIterator {
  public:
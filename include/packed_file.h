@@ -0,0 +1,79 @@
+#ifndef CHESSENGINE_PACKED_FILE_H
+#define CHESSENGINE_PACKED_FILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "mapped_file.h"
+
+// Files of packed positions start with this 8-byte magic, followed by
+// 32-byte PackedBoard records.
+constexpr char kPackedFileMagic[8] = {'C', 'E', 'P', 'A', 'C', 'K', '0', '1'};
+
+// Appends packed positions to a new file, buffering writes.
+class PackedWriter {
+ public:
+  // Creates or truncates the file. Throws std::runtime_error on failure.
+  explicit PackedWriter(const std::string& path);
+  // Flushes the remaining positions, see Close().
+  ~PackedWriter();
+
+  PackedWriter(const PackedWriter&) = delete;
+  PackedWriter& operator=(const PackedWriter&) = delete;
+
+  // Throws std::invalid_argument for positions that cannot be packed, and
+  // std::runtime_error if writing fails.
+  void Write(const Board& board);
+  // Flushes buffered positions to the file and closes it. Throws
+  // std::runtime_error if writing fails.
+  void Close();
+
+  size_t Count() const {
+    return this->count;
+  }
+
+ private:
+  void Flush();
+
+  std::string path;
+  FILE* file;
+  std::vector<PackedBoard> buffer;
+  size_t count = 0;
+};
+
+// Reads a file of packed positions, mapped into memory, sequentially or at
+// random.
+class PackedReader {
+ public:
+  // Throws std::runtime_error if the file cannot be read or is not a file
+  // of packed positions.
+  explicit PackedReader(const std::string& path);
+
+  size_t Count() const {
+    return this->count;
+  }
+
+  // Decodes the position at `index`. Returns false if it is malformed.
+  bool Get(size_t index, Board& board) const;
+
+  // Decodes the next well-formed position. Returns false at the end of the
+  // file.
+  bool Next(Board& board);
+
+  // Number of malformed positions skipped by Next().
+  size_t Malformed() const {
+    return this->malformed;
+  }
+
+ private:
+  MappedFile file;
+  const PackedBoard* records;
+  size_t count;
+  size_t position = 0;
+  size_t malformed = 0;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef CHESSENGINE_PERFT_H
+#define CHESSENGINE_PERFT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "board.h"
+#include "moves.h"
+
+struct PerftOptions {
+  int threads = 1;
+  // Number of plies expanded into separate tasks for the thread pool.
+  int split_depth = 2;
+  // Size of the table caching node counts of transposed subtrees, or 0 to
+  // count every subtree.
+  size_t hash_megabytes = 0;
+};
+
+struct DivideEntry {
+  Move move;
+  uint64_t nodes = 0;
+};
+
+// Counts the leaf nodes of the tree of legal moves to `depth` plies. The
+// last ply is counted in bulk, without playing out the moves.
+uint64_t Perft(const Board& board, int depth);
+
+// Counts the leaf nodes below each legal move in the position, in the
+// order the moves are generated. The tree is split into tasks for the
+// first `options.split_depth` plies, which are distributed over
+// `options.threads` workers with work stealing. The result does not depend
+// on the number of threads.
+std::vector<DivideEntry> ParallelPerft(
+  const Board& board, int depth, const PerftOptions& options);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef CHESSENGINE_PGN_H
+#define CHESSENGINE_PGN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "moves.h"
+
+struct PgnGame {
+  // Tag pairs in order of appearance.
+  std::vector<std::pair<std::string, std::string>> tags;
+  // Position before the first move, from the FEN tag if present.
+  Board start;
+  std::vector<Move> moves;
+  // Position after the last move.
+  Board end;
+  // "1-0", "0-1", "1/2-1/2" or "*".
+  std::string result;
+};
+
+// A game that could not be replayed.
+struct PgnError {
+  // Number of the game in the input, counting from 1.
+  uint64_t game;
+  std::string message;
+};
+
+struct PgnOptions {
+  int threads = 1;
+  // Size of the pieces of input parsed by one thread at a time. At most
+  // two chunks per thread are held in memory.
+  size_t chunk_bytes = 1 << 22;
+  // Errors kept for the result, all are counted.
+  size_t max_errors = 100;
+};
+
+struct PgnStats {
+  // Games replayed successfully.
+  uint64_t games = 0;
+  // Moves of those games.
+  uint64_t moves = 0;
+  // Games skipped because of errors.
+  uint64_t errors = 0;
+  uint64_t bytes = 0;
+  // The first errors in input order.
+  std::vector<PgnError> first_errors;
+};
+
+// Called for every game replayed, from the worker threads.
+using PgnVisitor = std::function<void(const PgnGame&)>;
+// Called from the calling thread about once a second while reading.
+using PgnProgress = std::function<void(const PgnStats&)>;
+
+// Reads a PGN database from the stream in chunks of whole games, which are
+// parsed in parallel: tags are collected, comments, variations and
+// annotations skipped, and the SAN movetext is replayed from the start
+// position or FEN tag. Games with illegal or malformed moves are counted
+// as errors and skipped.
+PgnStats ReplayPgn(std::istream& input,
+                   const PgnOptions& options,
+                   const PgnVisitor& visit = nullptr,
+                   const PgnProgress& progress = nullptr);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CHESSENGINE_POLYGLOT_H
+#define CHESSENGINE_POLYGLOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "mapped_file.h"
+#include "moves.h"
+
+// Returns the Polyglot hash of the position, from the Random64 table of the
+// Polyglot book format. The en passant file is only included if a pawn can
+// capture en passant.
+uint64_t PolyglotHash(const Board& board);
+
+struct BookMove {
+  Move move;
+  uint16_t weight;
+};
+
+enum class BookSelection {
+  // Chooses a move at random, in proportion to its weight.
+  WEIGHTED,
+  // Chooses the move with the highest weight.
+  BEST,
+};
+
+// An opening book in the Polyglot .bin format: 16-byte big endian entries
+// of key, move, weight and learning data, sorted by key. The file is mapped
+// into memory and searched in place.
+class PolyglotBook {
+ public:
+  // Throws std::runtime_error if the file cannot be read.
+  explicit PolyglotBook(const std::string& path);
+
+  // Returns the legal book moves of the position, by decreasing weight.
+  std::vector<BookMove> Lookup(const Board& board) const;
+
+  // Chooses a book move for the position, or nothing if it is not in the
+  // book or all its moves have zero weight.
+  std::optional<Move> Pick(const Board& board, BookSelection selection,
+                           std::mt19937_64& random) const;
+
+  size_t Count() const {
+    return this->count;
+  }
+
+ private:
+  MappedFile file;
+  size_t count;
+};
+
+#endif
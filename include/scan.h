@@ -0,0 +1,29 @@
+#ifndef CHESSENGINE_SCAN_H
+#define CHESSENGINE_SCAN_H
+
+#include <cstdint>
+
+#include "pieces.h"
+
+// Whole-board scans over the 64 contiguous bytes of the mailbox, indexed by
+// `rank * 8 + file`. The kernels compare all squares at once using the widest
+// vector instructions supported by the running CPU, and fall back to a scalar
+// loop elsewhere. The implementation is selected once at startup.
+
+struct PieceWeight {
+  Piece piece;
+  int weight;
+};
+
+// Returns a bitmask with bit `rank * 8 + file` set for every non-empty square
+// where `(piece & mask) == value`.
+uint64_t MatchOccupied(const Piece* squares, uint8_t mask, uint8_t value);
+
+// Returns the sum of the weights of all pieces on the board, where each square
+// holding exactly `weights[i].piece` contributes `weights[i].weight`.
+int WeightedCount(const Piece* squares, const PieceWeight* weights, int count);
+
+// Returns the name of the selected kernel implementation, for diagnostics.
+const char* ScanKernelName();
+
+#endif
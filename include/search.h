@@ -0,0 +1,131 @@
+#ifndef CHESSENGINE_SEARCH_H
+#define CHESSENGINE_SEARCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "board.h"
+#include "moves.h"
+#include "search_stats.h"
+#include "trace.h"
+#include "transposition.h"
+
+// Deepest iteration of any search.
+constexpr int kMaxDepth = 64;
+
+struct SearchLimits {
+  // Depth of the full-width search, in plies.
+  int depth = 1;
+  // Nodes visited by the main thread before the search is stopped, or 0
+  // for no limit. The result is taken from the last completed iteration.
+  uint64_t nodes = 0;
+  // Time in milliseconds after which the search is stopped, or 0 for no
+  // limit. The result is taken from the last completed iteration.
+  int64_t movetime = 0;
+  // Set by the caller to the time after which the search is stopped, in
+  // milliseconds of the steady clock, or 0 for no limit. Unlike the move
+  // time it may change while the search runs, e.g. to start the clock of a
+  // search that began on the opponent's time. May be null.
+  const std::atomic<int64_t>* deadline = nullptr;
+  // Number of threads searching the position. Threads beyond the first
+  // are helpers that only contribute through the shared hash table.
+  int threads = 1;
+  // Number of best root moves scored exactly, see SearchResult::lines.
+  // The other root moves are only shown to be worse, with null windows.
+  int multi_pv = 1;
+};
+
+// A root move with its score and expected line of play.
+struct SearchLine {
+  Move move;
+  // Score from white's point of view, as SearchResult::score.
+  int score = 0;
+  std::vector<Move> pv;
+};
+
+struct SearchResult {
+  // Score of the position in units of 1 / 100th pawn, positive values
+  // indicating advantage for white.
+  int score = 0;
+  std::optional<Move> best_move;
+  // Expected line of play, starting with the best move.
+  std::vector<Move> pv;
+  // The best SearchLimits::multi_pv root moves of the last completed
+  // iteration, best first. The first line is that of the best move.
+  std::vector<SearchLine> lines;
+  // Depth of the last fully completed iteration.
+  int depth = 0;
+  // Nodes visited by all threads.
+  uint64_t nodes = 0;
+  // Counters of all threads, see search_stats.h. Iterations are those of
+  // the main thread.
+  SearchStats stats;
+};
+
+// Returns the time in milliseconds to spend on a move, splitting the
+// remaining clock time over the moves left to the next time control,
+// assuming 30 moves if unknown.
+int64_t AllocateTime(int64_t time_left, int64_t increment, int moves_to_go);
+
+// Returns the time `milliseconds` from now, as stored in
+// SearchLimits::deadline.
+int64_t DeadlineAfter(int64_t milliseconds);
+
+// Called by the main search thread after every completed iteration. The
+// node count only includes the main thread until the search is done.
+using ProgressCallback = std::function<void(const SearchResult&)>;
+
+// Iterative deepening alpha-beta search, parallelised with lazy SMP: all
+// threads search the same position independently, at varying depths and
+// with varying root move orders, and share their results through the hash
+// table. The result of the main thread is reported.
+class Search {
+ public:
+  explicit Search(size_t table_megabytes = 16);
+  // Uses a table shared with other searches, which may run concurrently on
+  // other threads, so that each benefits from the results of the others.
+  explicit Search(std::shared_ptr<TranspositionTable> table);
+
+  Search(const Search&) = delete;
+  Search& operator=(const Search&) = delete;
+
+  // Searches the position within the given limits. Blocks until done, or
+  // until `stop_token` is set by another thread.
+  SearchResult Run(const Board& board,
+                   const SearchLimits& limits,
+                   const ProgressCallback& progress = nullptr,
+                   const std::atomic<bool>* stop_token = nullptr);
+
+  // Makes a running search return as soon as possible. Thread-safe, but has
+  // no effect on a search that has not started yet; use a stop token to
+  // cancel a search that is started asynchronously.
+  void Stop();
+
+  // Forgets all results from previous searches, including those of other
+  // searches sharing the table.
+  void Clear();
+
+  // Writes the statistics of every search as a line of JSON to `output`
+  // when the search ends, or stops doing so if null. Has no effect when
+  // statistics are compiled out.
+  void SetStatsOutput(std::ostream* output);
+
+  // Records every node visited by the main thread to `trace`, or stops
+  // doing so if null. The writer must outlive the searches. Throws
+  // std::runtime_error unless tracing is compiled in, see trace.h.
+  void SetTrace(TraceWriter* trace);
+
+ private:
+  std::shared_ptr<TranspositionTable> table;
+  std::atomic<bool> stop;
+  std::ostream* stats_output = nullptr;
+  TraceWriter* trace = nullptr;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef CHESSENGINE_SEARCH_ENGINE_H
+#define CHESSENGINE_SEARCH_ENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "board.h"
+#include "search.h"
+#include "thread_pool.h"
+#include "transposition.h"
+
+// Cancels the searches it is passed to. Copies share their state, so a
+// copy may be kept to stop a search running on another thread.
+class StopToken {
+ public:
+  StopToken() : state(std::make_shared<std::atomic<bool>>(false)) {}
+
+  void RequestStop() const {
+    this->state->store(true);
+  }
+  bool StopRequested() const {
+    return this->state->load();
+  }
+
+ private:
+  friend class SearchEngine;
+  std::shared_ptr<std::atomic<bool>> state;
+};
+
+struct EngineOptions {
+  // Size of the hash table shared by all searches of the engine.
+  size_t hash_megabytes = 16;
+  // Number of searches run at the same time. Further searches wait for a
+  // free worker. Each search may use several threads of its own, see
+  // SearchLimits::threads.
+  int workers = 1;
+};
+
+// Entry point for embedding the engine in another program. Owns a hash
+// table, which stays warm across searches, and a pool of worker threads
+// running searches in the background. All methods are thread-safe.
+class SearchEngine {
+ public:
+  explicit SearchEngine(const EngineOptions& options = EngineOptions());
+  // Stops all searches and waits for them to finish.
+  ~SearchEngine();
+
+  SearchEngine(const SearchEngine&) = delete;
+  SearchEngine& operator=(const SearchEngine&) = delete;
+
+  // Starts searching the position within the given limits and returns the
+  // future result. The progress callback is called from the worker thread
+  // after every completed iteration. A search stopped through `stop`, or
+  // by StopAll(), reports the last completed iteration; if stopped before
+  // it started, its result has depth 0.
+  std::future<SearchResult> Search(const Board& board,
+                                   const SearchLimits& limits,
+                                   const ProgressCallback& progress = nullptr,
+                                   const StopToken& stop = StopToken());
+
+  // Stops all waiting and running searches.
+  void StopAll();
+
+  // Forgets the results of previous searches. Should not be called while
+  // searching, as it would slow down the running searches.
+  void Clear();
+
+ private:
+  std::shared_ptr<TranspositionTable> table;
+  // One search per worker, indexed by ThreadPool::CurrentWorker().
+  std::vector<std::unique_ptr<::Search>> searches;
+
+  std::mutex mutex;
+  // Stop states of the waiting and running searches.
+  std::unordered_multiset<std::atomic<bool>*> active;
+
+  // Destroyed first, so that workers are done before the searches go.
+  ThreadPool pool;
+};
+
+#endif
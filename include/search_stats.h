@@ -0,0 +1,64 @@
+#ifndef CHESSENGINE_SEARCH_STATS_H
+#define CHESSENGINE_SEARCH_STATS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Counting is compiled out entirely when building with
+// -DCHESSENGINE_NO_STATS (`make STATS=0`), in which case all counters stay
+// zero.
+#ifdef CHESSENGINE_NO_STATS
+constexpr bool kSearchStats = false;
+#else
+constexpr bool kSearchStats = true;
+#endif
+
+// Counters of one search. Every search thread counts into its own copy,
+// without synchronisation, and the copies are merged when the search ends.
+struct SearchStats {
+  struct Iteration {
+    int depth = 0;
+    // Nodes of the iteration, alpha-beta and quiescence.
+    uint64_t nodes = 0;
+    double milliseconds = 0;
+    // Nodes of the iteration relative to those of the one before it.
+    double branching_factor = 0;
+  };
+
+  // Nodes of the alpha-beta and the quiescence search.
+  uint64_t nodes = 0;
+  uint64_t qnodes = 0;
+  // Static evaluations, one at every quiescence node.
+  uint64_t evaluations = 0;
+  // Beta cutoffs in the alpha-beta search, and those by the first move
+  // searched, a measure of move ordering.
+  uint64_t cutoffs = 0;
+  uint64_t first_move_cutoffs = 0;
+  // Hash table probes, those finding an entry, and those whose entry ended
+  // the search of the node.
+  uint64_t table_probes = 0;
+  uint64_t table_hits = 0;
+  uint64_t table_cutoffs = 0;
+  // Nodes scored by the endgame bitbases.
+  uint64_t bitbase_hits = 0;
+  // Deepest ply reached, including the quiescence search.
+  int selective_depth = 0;
+  // Completed iterations of the main thread.
+  std::vector<Iteration> iterations;
+
+  double FirstMoveCutoffRate() const {
+    return this->cutoffs == 0 ? 0 : static_cast<double>(this->first_move_cutoffs) / this->cutoffs;
+  }
+  double TableHitRate() const {
+    return this->table_probes == 0 ? 0 : static_cast<double>(this->table_hits) / this->table_probes;
+  }
+
+  // Adds the counters of another thread. Iterations are kept from this one.
+  void Merge(const SearchStats& other);
+
+  // Returns the statistics as a single line JSON object.
+  std::string ToJson() const;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef CHESSENGINE_SERVER_H
+#define CHESSENGINE_SERVER_H
+
+#include <cstddef>
+#include <string>
+
+struct ServerOptions {
+  // Address to listen on, see socket.h.
+  std::string address = "unix:/tmp/chessengine.sock";
+  // Number of positions analysed at the same time.
+  int threads = 1;
+  // Size of the hash table shared by all workers and kept across requests.
+  size_t hash_megabytes = 64;
+  // File the hash table is mapped from, if not empty, so that it survives
+  // restarts of the server, see TranspositionTable::Map().
+  std::string hash_file;
+  // Requests waiting or running beyond which new requests are rejected, so
+  // that clients notice overload instead of waiting unboundedly.
+  size_t max_queue = 64;
+  // Number of completed results remembered for repeated positions.
+  size_t cache_size = 4096;
+  // Depth of requests that specify no limits.
+  int depth = 6;
+};
+
+// Serves analysis requests on a socket, forever. Each connection sends
+// requests as one JSON object per line:
+//
+//   {"id": "1", "fen": "<FEN>", "depth": 8, "nodes": 0, "movetime": 0,
+//    "deadline": 500, "fresh": false, "hash": 0, "multipv": 1}
+//
+// where all fields but the FEN are optional. Fresh requests are searched
+// from an empty hash table and bypass the result cache, so that their
+// results do not depend on earlier requests. The table is "hash" megabytes,
+// so that results do not depend on the server either, or the server's table
+// size divided by its threads if 0. The deadline is in milliseconds
+// from the arrival of the request: requests still waiting by then fail, and
+// running ones report the last completed iteration. {"cancel": "1"} cancels
+// a waiting or running request of the same connection. Every request gets
+// exactly one response line, in order of completion:
+//
+//   {"id": "1", "fen": "<FEN>", "score": 25, "best_move": "e2e4",
+//    "pv": "e2e4 e7e5", "depth": 8, "nodes": 12345, "time_ms": 12,
+//    "cached": false}
+//
+// or {"id": "1", "error": "<reason>"}, where the reason is "busy" if the
+// queue is full, "duplicate id" if a request of the same non-empty id is in flight,
+// "cancelled", "deadline exceeded", "node limit too small" or "movetime too
+// small" if no iteration completed, or a parse error. With a
+// multipv above 1, results also list that many best moves, best first, from
+// the same search:
+//
+//   "lines": [{"move": "e2e4", "score": 25, "pv": "e2e4 e7e5"}, ...]
+//
+// Throws std::runtime_error if the address cannot be listened on.
+void RunServer(const ServerOptions& options);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef CHESSENGINE_SOCKET_H
+#define CHESSENGINE_SOCKET_H
+
+#include <string>
+
+// Sockets for the line-delimited protocols. Addresses are either
+// "unix:<path>" for a Unix domain socket, or "[host:]port" for TCP, with the
+// host defaulting to the loopback interface. Functions that create sockets
+// throw std::runtime_error on failure.
+
+// Returns a socket listening on `address`. An existing Unix socket file at
+// the path is replaced.
+int ListenOn(const std::string& address);
+
+// Returns a socket connected to `address`.
+int ConnectTo(const std::string& address);
+
+// Writes all of `data` to the socket. Returns false if the peer is gone.
+bool SendAll(int fd, const std::string& data);
+
+// Splits the data received on a socket into lines.
+class LineReader {
+ public:
+  explicit LineReader(int fd) : fd(fd) {}
+
+  // Reads the next line, without its line break. Returns false at the end of
+  // the stream, on errors, or if no complete line arrives within
+  // `timeout_ms` milliseconds when non-negative.
+  bool ReadLine(std::string& line, int timeout_ms = -1);
+
+  // Whether the peer has closed the stream or it failed, as opposed to a
+  // timeout of the last read.
+  bool Closed() const {
+    return this->closed;
+  }
+
+ private:
+  int fd;
+  std::string buffer;
+  bool closed = false;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef CHESSENGINE_THREAD_POOL_H
+#define CHESSENGINE_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads with work stealing. Each worker has its
+// own task queue: tasks submitted from a worker are pushed to its own queue
+// and popped in LIFO order, while idle workers steal the oldest tasks from
+// the other queues.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  // Waits for all submitted tasks to complete before joining the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Schedules a task to be run on one of the workers.
+  void Submit(std::function<void()> task);
+
+  // Blocks until all submitted tasks have completed. Must not be called
+  // from a worker thread.
+  void Wait();
+
+  int Size() const {
+    return static_cast<int>(this->threads.size());
+  }
+
+  // Returns the index of the calling worker thread in its pool, or -1 if
+  // called from a thread not owned by a pool.
+  static int CurrentWorker();
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void WorkerLoop(int index);
+  bool TryPop(int index, std::function<void()>& task);
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  // Tasks waiting in any queue, and tasks not yet completed.
+  size_t queued = 0;
+  size_t pending = 0;
+  size_t next_queue = 0;
+  bool shutdown = false;
+};
+
+#endif
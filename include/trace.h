@@ -0,0 +1,111 @@
+#ifndef CHESSENGINE_TRACE_H
+#define CHESSENGINE_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Tracing is only compiled into the search when building with
+// -DCHESSENGINE_TRACE (`make TRACE=1`), so that other builds pay nothing
+// for it.
+#ifdef CHESSENGINE_TRACE
+constexpr bool kSearchTrace = true;
+#else
+constexpr bool kSearchTrace = false;
+#endif
+
+// Trace files start with this 8-byte magic, followed by the records in the
+// byte order of the machine.
+constexpr char kTraceFileMagic[8] = {'C', 'E', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// Why a node returned its score.
+enum class TraceReason : uint8_t {
+  // All moves were searched.
+  SEARCHED,
+  // A move refuted the move leading to the node.
+  CUTOFF,
+  // The hash table entry of the position was deep enough.
+  TABLE,
+  BITBASE,
+  FIFTY_MOVES,
+  // The static evaluation was good enough without searching captures.
+  STAND_PAT,
+  CHECKMATE,
+  STALEMATE,
+  // The search was stopped, and the score is meaningless.
+  STOPPED,
+};
+
+const char* TraceReasonName(TraceReason reason);
+
+// A node of the search tree, written when the node returns. Nodes are thus
+// in post-order: the children of a node are the nodes one ply deeper
+// written since the last node at its ply or above. Each iteration ends
+// with its root, at ply 0.
+struct TraceRecord {
+  // Window the node was searched with, from white's point of view.
+  int32_t alpha;
+  int32_t beta;
+  int32_t score;
+  // The move leading to the node, see PackMove(), or 0 for the root.
+  uint32_t move;
+  uint16_t ply;
+  // Remaining depth, or minus the depth of a quiescence search node.
+  int8_t depth;
+  TraceReason reason;
+};
+static_assert(sizeof(TraceRecord) == 20, "trace records are stored as they are");
+
+// Writes a trace file, buffering records. Not thread-safe; only the main
+// search thread writes to it.
+class TraceWriter {
+ public:
+  // Creates the file. Throws std::runtime_error if it cannot be created.
+  explicit TraceWriter(const std::string& path);
+  ~TraceWriter();
+
+  TraceWriter(const TraceWriter&) = delete;
+  TraceWriter& operator=(const TraceWriter&) = delete;
+
+  void Write(const TraceRecord& record) {
+    this->buffer.push_back(record);
+    if (this->buffer.size() == this->buffer.capacity()) {
+      this->Flush();
+    }
+  }
+
+  // Throws std::runtime_error if writing failed.
+  void Close();
+
+ private:
+  void Flush();
+
+  std::string path;
+  FILE* file;
+  std::vector<TraceRecord> buffer;
+};
+
+// Reads a trace file in place, mapped into memory.
+class TraceReader {
+ public:
+  // Throws std::runtime_error if the file cannot be read or is not a trace.
+  explicit TraceReader(const std::string& path);
+
+  size_t Count() const {
+    return this->count;
+  }
+  const TraceRecord& operator[](size_t index) const {
+    return this->records[index];
+  }
+
+ private:
+  MappedFile file;
+  const TraceRecord* records;
+  size_t count;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef CHESSENGINE_TRAINING_H
+#define CHESSENGINE_TRAINING_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "mapped_file.h"
+
+// Files of training positions start with this 8-byte magic, followed by the
+// records in the byte order of the machine.
+constexpr char kTrainingFileMagic[8] = {'C', 'E', 'T', 'R', 'A', 'I', 'N', '1'};
+
+// A position of a self-play game, labelled for fitting the evaluation.
+struct TrainingRecord {
+  PackedBoard board;
+  // Score of the search of the position, from white's point of view.
+  int16_t score;
+  // Result of the game: 1 if white won, 0 for a draw and -1 if black won.
+  int8_t result;
+  uint8_t reserved;
+};
+static_assert(sizeof(TrainingRecord) == 36, "training records are stored as they are");
+
+// Appends records to a training file, so that an interrupted run can be
+// continued. Buffered records are written to the file at least once per
+// flush interval, which bounds the work lost to a crash.
+class TrainingWriter {
+ public:
+  // Opens the file at `path`, creating it if it does not exist. A partial
+  // record at the end of an existing file, left by an interrupted run, is
+  // cut off. Throws std::runtime_error if the file cannot be opened or is
+  // not a training file.
+  TrainingWriter(const std::string& path, std::chrono::seconds flush_interval);
+  // Flushes the remaining records, see Close().
+  ~TrainingWriter();
+
+  TrainingWriter(const TrainingWriter&) = delete;
+  TrainingWriter& operator=(const TrainingWriter&) = delete;
+
+  void Write(const TrainingRecord& record);
+  // Writes the buffered records through to the file.
+  void Flush();
+  // Flushes and closes the file. Throws std::runtime_error if writing
+  // failed.
+  void Close();
+
+  // Records in the file, including those of earlier runs.
+  uint64_t Count() const {
+    return this->count;
+  }
+
+ private:
+  std::string path;
+  FILE* file = nullptr;
+  std::vector<TrainingRecord> buffer;
+  uint64_t count = 0;
+  std::chrono::seconds flush_interval;
+  std::chrono::steady_clock::time_point last_flush;
+};
+
+// Reads a training file in place, mapped into memory.
+class TrainingReader {
+ public:
+  // Throws std::runtime_error if the file cannot be read or is not a
+  // training file.
+  explicit TrainingReader(const std::string& path);
+
+  size_t Count() const {
+    return this->count;
+  }
+  const TrainingRecord& operator[](size_t index) const {
+    return this->records[index];
+  }
+
+ private:
+  MappedFile file;
+  const TrainingRecord* records;
+  size_t count;
+};
+
+#endif
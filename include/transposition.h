@@ -0,0 +1,85 @@
+#ifndef CHESSENGINE_TRANSPOSITION_H
+#define CHESSENGINE_TRANSPOSITION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "moves.h"
+
+// How the stored score relates to the true value of the position.
+enum class Bound : uint8_t {
+  NONE = 0,
+  EXACT = 1,
+  // The true value is at least the stored score.
+  LOWER = 2,
+  // The true value is at most the stored score.
+  UPPER = 3,
+};
+
+struct TableEntry {
+  int score = 0;
+  int depth = 0;
+  Bound bound = Bound::NONE;
+  std::optional<Move> move;
+};
+
+// Identifies the data of saved tables. Bump when the layout of entries or
+// the meaning of stored scores changes, so that older files are rejected
+// as stale. Tables of another hash function or evaluation are rejected
+// regardless.
+constexpr uint64_t kTableVersion = 1;
+
+// Hash table of previously searched positions, shared by all search threads.
+// Entries are stored as two 64-bit words with the key xor'ed by the data, so
+// that torn writes from concurrent threads are detected on probing instead
+// of requiring locks.
+//
+// Tables can be kept in files, which start with a 64-byte header holding a
+// magic, the version and fingerprint of the engine and the number and size
+// of slots, followed by the slots in the byte order of the machine.
+class TranspositionTable {
+ public:
+  explicit TranspositionTable(size_t megabytes);
+  ~TranspositionTable();
+
+  TranspositionTable(const TranspositionTable&) = delete;
+  TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+  // Returns a table of `megabytes` backed by a shared mapping of the file
+  // at `path`, created if it does not exist. Entries are loaded lazily by
+  // the kernel and written back as they change, so the table survives
+  // restarts without saving. Throws std::runtime_error if the file cannot
+  // be mapped, or holds a stale table or one of another size.
+  static std::shared_ptr<TranspositionTable> Map(const std::string& path, size_t megabytes);
+
+  // Returns the entry stored for the position with hash `key`, if any.
+  std::optional<TableEntry> Probe(uint64_t key) const;
+  // Stores an entry for the position with hash `key`, replacing the
+  // current entry in the slot unless it is from a deeper search of the same
+  // position.
+  void Store(uint64_t key, const TableEntry& entry);
+
+  // Removes all entries.
+  void Clear();
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+
+  TranspositionTable() = default;
+
+  Slot* slots = nullptr;
+  size_t size = 0;
+  // Either owns the slots, or maps the file holding them.
+  std::unique_ptr<Slot[]> owned;
+  void* mapping = nullptr;
+  size_t mapping_bytes = 0;
+};
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef CHESSENGINE_UCI_H
+#define CHESSENGINE_UCI_H
+
+#include <istream>
+#include <ostream>
+
+// Speaks the UCI protocol on the given streams until "quit" or the end of
+// the input. Searches run on a separate thread, so that commands such as
+// "stop" and "isready" are handled while searching.
+void RunUci(std::istream& input, std::ostream& output);
+
+#endif
@@ -0,0 +1,213 @@
+#include "batch.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "json.h"
+#include "moves.h"
+#include "search.h"
+#include "thread_pool.h"
+
+namespace {
+
+struct Job {
+  uint64_t index;
+  std::string fen;
+  SearchLimits limits;
+};
+
+struct JobResult {
+  std::string fen;
+  std::optional<SearchResult> result;
+  std::string error;
+  double milliseconds = 0;
+};
+
+std::string Trim(const std::string& text) {
+  const size_t first = text.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    return "";
+  }
+  const size_t last = text.find_last_not_of(" \t\r\n");
+  return text.substr(first, last - first + 1);
+}
+
+std::string CsvEscape(const std::string& text) {
+  if (text.find_first_of(",\"\n") == std::string::npos) {
+    return text;
+  }
+  std::string output = "\"";
+  for (const char c : text) {
+    if (c == '"') {
+      output.push_back('"');
+    }
+    output.push_back(c);
+  }
+  output.push_back('"');
+  return output;
+}
+
+void WriteResult(std::ostream& output, BatchFormat format, const JobResult& job) {
+  const SearchResult* result = job.result.has_value() ? &*job.result : nullptr;
+  const std::string best_move = (
+    result != nullptr && result->best_move.has_value() ? MoveToString(*result->best_move) : "");
+
+  if (format == BatchFormat::CSV) {
+    output << CsvEscape(job.fen) << ',';
+    if (result != nullptr) {
+      output << result->score << ',' << best_move << ',' << result->depth << ','
+             << result->nodes << ',' << static_cast<uint64_t>(job.milliseconds);
+    }
+    else {
+      output << ",,,,";
+    }
+    output << ',' << CsvEscape(job.error) << '\n';
+    return;
+  }
+
+  output << "{\"fen\":\"" << JsonEscape(job.fen) << '"';
+  if (result != nullptr) {
+    output << ",\"score\":" << result->score
+           << ",\"best_move\":\"" << best_move << '"'
+           << ",\"depth\":" << result->depth
+           << ",\"nodes\":" << result->nodes
+           << ",\"time_ms\":" << static_cast<uint64_t>(job.milliseconds);
+  }
+  else {
+    output << ",\"error\":\"" << JsonEscape(job.error) << '"';
+  }
+  output << "}\n";
+}
+
+}  // namespace
+
+bool ParseBatchLine(const std::string& line, const BatchOptions& options,
+                    std::string& fen, SearchLimits& limits) {
+  std::istringstream stream(line);
+  std::string field;
+  std::getline(stream, field, ';');
+  fen = Trim(field);
+  if (fen.empty() || fen[0] == '#') {
+    return false;
+  }
+
+  limits.depth = options.depth;
+  limits.nodes = options.nodes;
+  bool has_depth = false;
+  while (std::getline(stream, field, ';')) {
+    std::istringstream limit(field);
+    std::string name;
+    uint64_t value = 0;
+    if (!(limit >> name >> value)) {
+      continue;
+    }
+    if (name == "depth") {
+      limits.depth = static_cast<int>(value);
+      has_depth = true;
+    }
+    else if (name == "nodes") {
+      limits.nodes = value;
+    }
+  }
+  if (limits.nodes != 0 && !has_depth && options.nodes == 0) {
+    // A node limit for this position only replaces the default depth.
+    limits.depth = kMaxDepth;
+  }
+  return true;
+}
+
+uint64_t AnalyseBatch(std::istream& input, std::ostream& output, const BatchOptions& options) {
+  ThreadPool pool(options.threads);
+  const size_t window = options.window > 0 ? options.window : 4 * pool.Size();
+
+  // One search per worker, so that hash tables are allocated only once.
+  std::vector<std::unique_ptr<Search>> searches;
+  for (int i = 0; i < pool.Size(); i++) {
+    searches.push_back(std::make_unique<Search>(options.hash_megabytes));
+  }
+
+  std::mutex mutex;
+  std::condition_variable finished_cv;
+  // Results not yet written, by input index.
+  std::map<uint64_t, JobResult> finished;
+  uint64_t next_index = 0;
+  uint64_t next_to_write = 0;
+
+  // Writes all results that are next in order. Expects `mutex` to be held.
+  const auto write_ready = [&]() {
+    for (auto it = finished.begin();
+         it != finished.end() && it->first == next_to_write;
+         it = finished.erase(it)) {
+      WriteResult(output, options.format, it->second);
+      next_to_write++;
+    }
+  };
+
+  if (options.format == BatchFormat::CSV) {
+    output << "fen,score,best_move,depth,nodes,time_ms,error\n";
+  }
+
+  std::string line;
+  while (std::getline(input, line)) {
+    Job job;
+    if (!ParseBatchLine(line, options, job.fen, job.limits)) {
+      continue;
+    }
+    job.index = next_index++;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      write_ready();
+      while (job.index - next_to_write >= window) {
+        output.flush();
+        finished_cv.wait(lock);
+        write_ready();
+      }
+    }
+
+    pool.Submit([&, job]() {
+      Search& search = *searches[ThreadPool::CurrentWorker()];
+      // Start every position from an empty table, so that results do not
+      // depend on which positions the worker analysed before.
+      search.Clear();
+
+      JobResult job_result;
+      job_result.fen = job.fen;
+      const auto start = std::chrono::steady_clock::now();
+      try {
+        job_result.result = search.Run(Board::FromFEN(job.fen), job.limits);
+      }
+      catch (const std::exception& error) {
+        job_result.error = std::string("invalid position: ") + error.what();
+      }
+      const std::chrono::duration<double, std::milli> elapsed = (
+        std::chrono::steady_clock::now() - start);
+      job_result.milliseconds = elapsed.count();
+
+      std::lock_guard<std::mutex> lock(mutex);
+      finished.emplace(job.index, std::move(job_result));
+      finished_cv.notify_one();
+    });
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  write_ready();
+  while (next_to_write < next_index) {
+    output.flush();
+    finished_cv.wait(lock);
+    write_ready();
+  }
+  output.flush();
+  lock.unlock();
+  pool.Wait();
+  return next_index;
+}
@@ -0,0 +1,152 @@
+#include "bitbase.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "board.h"
+#include "evaluation.h"
+#include "mapped_file.h"
+#include "pieces.h"
+#include "scan.h"
+
+namespace {
+
+// Mapped bitbases, by index in kBitbaseMaterials. Null if not loaded.
+std::unique_ptr<MappedFile> bitbases[kNumBitbases];
+
+int Distance(int a, int b) {
+  return std::max(std::abs(a % 8 - b % 8), std::abs(a / 8 - b / 8));
+}
+
+// Distance of the square from the four center squares, 0 to 3.
+int CenterDistance(int square) {
+  const int file = square % 8;
+  const int rank = square / 8;
+  return std::max(file < 4 ? 3 - file : file - 4, rank < 4 ? 3 - rank : rank - 4);
+}
+
+// Number of squares of the part of the board that a rook or queen on
+// `piece` cuts the king on `king` off in, 64 if it cuts off nothing.
+int BoxArea(int piece, int king) {
+  const auto side = [](int line, int king_line) {
+    return king_line < line ? line : king_line > line ? 7 - line : 8;
+  };
+  return side(piece % 8, king % 8) * side(piece / 8, king / 8);
+}
+
+}  // namespace
+
+size_t LoadBitbases(const std::string& directory) {
+  size_t loaded = 0;
+  for (size_t i = 0; i < kNumBitbases; i++) {
+    bitbases[i].reset();
+    const std::string path = directory + "/" + kBitbaseMaterials[i].name + ".bb";
+    try {
+      auto file = std::make_unique<MappedFile>(path);
+      const uint64_t bytes = sizeof(kBitbaseMagic) + BitbasePositions(kBitbaseMaterials[i]) / 8;
+      if (file->Size() != bytes || memcmp(file->Data(), kBitbaseMagic, sizeof(kBitbaseMagic)) != 0) {
+        continue;
+      }
+      bitbases[i] = std::move(file);
+      loaded++;
+    }
+    catch (const std::runtime_error&) {
+      // Missing bitbases are not probed.
+    }
+  }
+  return loaded;
+}
+
+std::optional<int> ProbeBitbases(const Board& board) {
+  uint64_t occupied = MatchOccupied(board.Squares(), 0, 0);
+  if (__builtin_popcountll(occupied) > 4) {
+    return std::nullopt;
+  }
+
+  // Exactly one side may have pieces besides its king.
+  bool strong_white = true;
+  bool has_strong_side = false;
+  // At most two, besides the kings.
+  int squares[2];
+  Piece types[2];
+  int num_pieces = 0;
+  while (occupied != 0) {
+    const int square = __builtin_ctzll(occupied);
+    occupied &= occupied - 1;
+    const Piece piece = board.Squares()[square];
+    const bool white = piece & Piece::IS_WHITE;
+    if (piece & Piece::KING) {
+      continue;
+    }
+    if (has_strong_side && white != strong_white) {
+      return std::nullopt;
+    }
+    has_strong_side = true;
+    strong_white = white;
+    squares[num_pieces] = square;
+    types[num_pieces] = static_cast<Piece>(static_cast<uint8_t>(piece) & 63);
+    num_pieces++;
+  }
+  if (num_pieces == 0 || (num_pieces == 1 && (types[0] == Piece::KNIGHT || types[0] == Piece::BISHOP))) {
+    // No side can mate.
+    return 0;
+  }
+
+  // Mirror the board so that the strong side plays white.
+  const int mirror = strong_white ? 0 : 56;
+  const SquareIndex strong = board.KingsPosition(strong_white);
+  const SquareIndex weak = board.KingsPosition(!strong_white);
+  const int strong_king = (strong.rank * 8 + strong.file) ^ mirror;
+  const int weak_king = (weak.rank * 8 + weak.file) ^ mirror;
+
+  for (size_t i = 0; i < kNumBitbases; i++) {
+    const BitbaseMaterial& material = kBitbaseMaterials[i];
+    if (material.num_pieces != num_pieces || bitbases[i] == nullptr) {
+      continue;
+    }
+    // Order the pieces as in the material set.
+    int pieces[2];
+    bool matches = true;
+    bool used[2] = {false, false};
+    for (int j = 0; j < num_pieces && matches; j++) {
+      matches = false;
+      for (int k = 0; k < num_pieces; k++) {
+        if (!used[k] && types[k] == material.pieces[j]) {
+          pieces[j] = squares[k] ^ mirror;
+          used[k] = true;
+          matches = true;
+          break;
+        }
+      }
+    }
+    if (!matches) {
+      continue;
+    }
+
+    const uint64_t index = BitbaseIndex(
+      material, board.WhiteToMove() == strong_white, strong_king, weak_king, pieces);
+    const uint8_t byte = static_cast<uint8_t>(bitbases[i]->Data()[sizeof(kBitbaseMagic) + index / 8]);
+    if (!(byte & (1 << (index % 8)))) {
+      return 0;
+    }
+    // Wins are all alike to the bitbase. Prefer positions closer to the
+    // end: the weak king at the edge and near the strong king, and the
+    // pawn further up the board.
+    int bonus = 20 * CenterDistance(weak_king) + 10 * (7 - Distance(strong_king, weak_king));
+    if (material.pieces[0] == Piece::PAWN) {
+      bonus += 50 * (pieces[0] / 8);
+    }
+    else if (material.pieces[0] == Piece::ROOK || material.pieces[0] == Piece::QUEEN) {
+      // The king is mated by shrinking its box.
+      bonus += 2 * (64 - BoxArea(pieces[0], weak_king));
+    }
+    const int score = kBitbaseWin + std::abs(CountPieces(&board)) + bonus;
+    return strong_white ? score : -score;
+  }
+  return std::nullopt;
+}
@@ -1,34 +1,135 @@
 #include "board.h"
 
-#include <cassert>
 #include <cstring>
+#include <algorithm>
 #include <cctype>
 #include <cstdint>
 #include <iostream>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 #include "pieces.h"
+#include "scan.h"
 
 
 namespace {
 
-int8_t RookPosition(const Board& board, Castling side, int8_t rank) {
-  if (side == Castling::QUEENSIDE) {
-    for (int8_t i = 0; i < 8; i++) {
-      if (board.Get(i, rank) & Piece::ROOK) {
-        return i;
+// Random keys for Zobrist hashing, generated at compile time with
+// SplitMix64 from a fixed seed so that hashes are stable between builds.
+struct ZobristKeys {
+  uint64_t pieces[2][6][64];
+  uint64_t castling[2][4];
+  uint64_t en_passent[8];
+  uint64_t white_to_move;
+};
+
+constexpr uint64_t SplitMix64(uint64_t& state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys MakeZobristKeys() {
+  ZobristKeys keys = {};
+  uint64_t state = 0x2545F4914F6CDD1DULL;
+  for (int color = 0; color < 2; color++) {
+    for (int type = 0; type < 6; type++) {
+      for (int square = 0; square < 64; square++) {
+        keys.pieces[color][type][square] = SplitMix64(state);
       }
     }
+    for (int rights = 0; rights < 4; rights++) {
+      keys.castling[color][rights] = rights == 0 ? 0 : SplitMix64(state);
+    }
+  }
+  for (int file = 0; file < 8; file++) {
+    keys.en_passent[file] = SplitMix64(state);
+  }
+  keys.white_to_move = SplitMix64(state);
+  return keys;
+}
+
+constexpr ZobristKeys kZobrist = MakeZobristKeys();
+
+int8_t RookPosition(const Board& board, Castling side, int8_t rank) {
+  // Only one rank is of interest, which is cheaper to scan directly.
+  uint32_t rank_rooks = 0;
+  for (int8_t file = 0; file < 8; file++) {
+    rank_rooks |= (board.Get(file, rank) & Piece::ROOK ? 1u : 0u) << file;
+  }
+  if (rank_rooks == 0) {
+    return -1;
+  }
+  if (side == Castling::QUEENSIDE) {
+    return __builtin_ctz(rank_rooks);
   }
   else {
-    for (int8_t i = 7; i >=0; i--) {
-      if (board.Get(i, rank) & Piece::ROOK) {
-        return i;
-      }
-    }
+    return 31 - __builtin_clz(rank_rooks);
   }
-  return -1;
+}
+
+Piece PieceFromChar(char c) {
+  const Piece color = 'A' <= c && c <= 'Z' ? Piece::IS_WHITE : Piece::EMPTY;
+  switch (c | 0x20) {
+    case 'p': return Piece::PAWN | color;
+    case 'n': return Piece::KNIGHT | color;
+    case 'b': return Piece::BISHOP | color;
+    case 'r': return Piece::ROOK | color;
+    case 'q': return Piece::QUEEN | color;
+    case 'k': return Piece::KING | color;
+  }
+  return Piece::EMPTY;
+}
+
+char PieceToChar(Piece piece) {
+  const int add_case = piece & Piece::IS_WHITE ? 'A' - 'a' : 0;
+  if (piece & Piece::PAWN) {
+    return 'p' + add_case;
+  }
+  else if (piece & Piece::KNIGHT) {
+    return 'n' + add_case;
+  }
+  else if (piece & Piece::BISHOP) {
+    return 'b' + add_case;
+  }
+  else if (piece & Piece::ROOK) {
+    return 'r' + add_case;
+  }
+  else if (piece & Piece::QUEEN) {
+    return 'q' + add_case;
+  }
+  return 'k' + add_case;
+}
+
+// 4-bit codes of packed positions: the index of the piece type from pawn
+// to king, plus 8 for white pieces.
+uint8_t PieceCode(Piece piece) {
+  const uint8_t type = static_cast<uint8_t>(piece) & ~static_cast<uint8_t>(Piece::IS_WHITE);
+  return __builtin_ctz(type) | (piece & Piece::IS_WHITE ? 8 : 0);
+}
+
+Piece PieceFromCode(uint8_t code) {
+  if ((code & 7) > 5) {
+    return Piece::EMPTY;
+  }
+  return static_cast<Piece>(1 << (code & 7)) | (code & 8 ? Piece::IS_WHITE : Piece::EMPTY);
+}
+
+// Writes a non-negative number in decimal and returns the end of it.
+char* WriteNumber(char* output, int value) {
+  char digits[10];
+  int count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0 && count < 10);
+  while (count > 0) {
+    *output++ = digits[--count];
+  }
+  return output;
 }
 
 }  // namespace
@@ -164,157 +265,252 @@ void Board::Move(SquareIndex from, SquareIndex to, Piece promotion, Castling cas
 
 std::optional<SquareIndex> Board::NextOccupied(
 	SquareIndex square, bool white) const {
-	while (true) {
-		// Increment position;
-		if (++square.file >= 8) {
-			square.file = 0;
-			if (++square.rank >= 8) {
-				return std::nullopt;
-			}
-		}
-		const Piece current_piece = this->Get(square.file, square.rank);
-		if (
-			current_piece != Piece::EMPTY &&
-			static_cast<bool>(current_piece & Piece::IS_WHITE) == white
-		) {
-			return square;
-		}
+	const int index = square.rank * 8 + square.file + 1;
+	if (index >= 64) {
+		return std::nullopt;
+	}
+	// Only consider pieces on squares after the current one.
+	const uint64_t remaining = this->Occupancy(white) & (~uint64_t{0} << index);
+	if (remaining == 0) {
+		return std::nullopt;
 	}
+	const int next = __builtin_ctzll(remaining);
+	return SquareIndex{
+		.file = static_cast<int8_t>(next % 8),
+		.rank = static_cast<int8_t>(next / 8),
+	};
 }
 
-Board Board::FromFEN(const std::string& fen) {
-  Board board;
+uint64_t Board::Occupancy(bool white) const {
+	const uint8_t color = white ? static_cast<uint8_t>(Piece::IS_WHITE) : 0;
+	return MatchOccupied(
+		this->Squares(), static_cast<uint8_t>(Piece::IS_WHITE), color);
+}
+
+uint64_t Board::Hash() const {
+  uint64_t hash = 0;
+  uint64_t occupied = MatchOccupied(this->Squares(), 0, 0);
+  while (occupied != 0) {
+    const int index = __builtin_ctzll(occupied);
+    occupied &= occupied - 1;
+
+    const Piece piece = this->Squares()[index];
+    const int color = piece & Piece::IS_WHITE ? 0 : 1;
+    const int type = __builtin_ctz(static_cast<uint8_t>(piece) & 63);
+    hash ^= kZobrist.pieces[color][type][index];
+  }
+  hash ^= kZobrist.castling[0][static_cast<uint8_t>(this->castling[0]) & 3];
+  hash ^= kZobrist.castling[1][static_cast<uint8_t>(this->castling[1]) & 3];
+  if (this->en_passent.has_value()) {
+    hash ^= kZobrist.en_passent[this->en_passent->file];
+  }
+  if (this->white_to_move) {
+    hash ^= kZobrist.white_to_move;
+  }
+  return hash;
+}
+
+void Board::FindRookStartFiles() {
+  this->queenside_rook_start_file = 0;
+  this->kingside_rook_start_file = 7;
+  if (this->castling[0] & Castling::KINGSIDE) {
+    this->kingside_rook_start_file = RookPosition(*this, Castling::KINGSIDE, 0);
+  }
+  else if(this->castling[1] & Castling::KINGSIDE) {
+    this->kingside_rook_start_file = RookPosition(*this, Castling::KINGSIDE, 7);
+  }
+  if (this->castling[0] & Castling::QUEENSIDE) {
+    this->queenside_rook_start_file = RookPosition(*this, Castling::QUEENSIDE, 0);
+  }
+  else if(this->castling[1] & Castling::QUEENSIDE) {
+    this->queenside_rook_start_file = RookPosition(*this, Castling::QUEENSIDE, 7);
+  }
+}
+
+bool Board::HasCastlingRooks() const {
+  for (int color = 0; color < 2; color++) {
+    if (this->castling[color] == Castling::NO_CASTLING) {
+      continue;
+    }
+    const int8_t rank = color == 0 ? 0 : 7;
+    const SquareIndex king = this->kings_position[color];
+    if (king.rank != rank) {
+      return false;
+    }
+    const Piece rook = Piece::ROOK | (color == 0 ? Piece::IS_WHITE : Piece::EMPTY);
+    for (const Castling side : {Castling::KINGSIDE, Castling::QUEENSIDE}) {
+      if (!(this->castling[color] & side)) {
+        continue;
+      }
+      const int8_t file = (
+        side == Castling::KINGSIDE ? this->kingside_rook_start_file
+                                   : this->queenside_rook_start_file);
+      if (file < 0 || this->squares[rank][file] != rook ||
+          (side == Castling::KINGSIDE ? file <= king.file : file >= king.file)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+const char* FenErrorMessage(FenError error) {
+  switch (error) {
+    case FenError::OK: return "ok";
+    case FenError::BAD_PLACEMENT: return "bad piece placement";
+    case FenError::MISSING_KING: return "missing or extra king";
+    case FenError::BAD_SIDE_TO_MOVE: return "bad side to move";
+    case FenError::BAD_CASTLING: return "bad castling rights";
+    case FenError::BAD_EN_PASSANT: return "bad en passant square";
+    case FenError::BAD_CLOCK: return "bad move clock";
+    case FenError::TRAILING_CHARACTERS: return "trailing characters";
+  }
+  return "unknown error";
+}
+
+FenError Board::ParseFEN(std::string_view fen, Board& board) {
   memset(board.squares, 0, sizeof(board.squares));
   memset(board.castling, 0, sizeof(board.castling));
+  board.en_passent = std::nullopt;
 
-  int chars_read = 0;
+  // Read position of pieces.
+  size_t pos = 0;
   int8_t rank = 7;
   int8_t file = 0;
-
-  // Read position of pieces.
-  for (char c : fen) {
-    chars_read++;
-
+  int kings[2] = {0, 0};
+  for (; pos < fen.size() && fen[pos] != ' '; pos++) {
+    const char c = fen[pos];
     if (c == '/') {
+      if (file != 8 || rank == 0) {
+        return FenError::BAD_PLACEMENT;
+      }
       rank--;
       file = 0;
       continue;
     }
-    else if(std::isdigit(c)) {
+    if ('1' <= c && c <= '8') {
       file += c - '0';
+      if (file > 8) {
+        return FenError::BAD_PLACEMENT;
+      }
       continue;
     }
-    else if (c == ' ') {
-      // Position should be fully read, left is special state information.
-      break;
-    }
-    assert(0 <= file && file < 8);
-    assert(0 <= rank && rank < 8);
-
-    const bool is_white = std::isupper(c);
-    const char ch = std::tolower(c);
-    if (ch == 'p') {
-      board.squares[rank][file] = Piece::PAWN;
-    }
-    else if (ch == 'n') {
-      board.squares[rank][file] = Piece::KNIGHT;
-    }
-    else if(ch == 'b') {
-      board.squares[rank][file] = Piece::BISHOP;
-    }
-    else if (ch == 'r') {
-      board.squares[rank][file] = Piece::ROOK;
+    const Piece piece = PieceFromChar(c);
+    if (piece == Piece::EMPTY || file >= 8 ||
+        ((piece & Piece::PAWN) && (rank == 0 || rank == 7))) {
+      return FenError::BAD_PLACEMENT;
     }
-    else if (ch == 'q') {
-      board.squares[rank][file] = Piece::QUEEN;
-    }
-    else if (ch == 'k') {
-      board.squares[rank][file] = Piece::KING;
+    board.squares[rank][file] = piece;
+    if (piece & Piece::KING) {
+      const bool is_white = piece & Piece::IS_WHITE;
+      kings[!is_white]++;
       board.kings_position[!is_white] = {.file = file, .rank = rank};
     }
-    if (is_white) {
-      board.squares[rank][file] = board.squares[rank][file] | Piece::IS_WHITE;
-    }
     file++;
   }
-
-  // Size to move
-  if (fen.at(chars_read++) == 'w') {
-    board.white_to_move = true;
+  if (rank != 0 || file != 8) {
+    return FenError::BAD_PLACEMENT;
   }
-  else {
-    board.white_to_move = false;
+  if (kings[0] != 1 || kings[1] != 1) {
+    return FenError::MISSING_KING;
   }
 
-  // Castling priviliges.
-  while (++chars_read < fen.size()) {
-    if (fen.at(chars_read) == 'K') {
-      board.castling[0] = board.castling[0] | Castling::KINGSIDE;
-    }
-    else if (fen.at(chars_read) == 'Q') {
-      board.castling[0] = board.castling[0] | Castling::QUEENSIDE;
-    }
-    else if (fen.at(chars_read) == 'k') {
-      board.castling[1] = board.castling[1] | Castling::KINGSIDE;
-    }
-    else if (fen.at(chars_read) == 'q') {
-      board.castling[1] = board.castling[1] | Castling::QUEENSIDE;
-    }
-    else if (fen.at(chars_read) == ' ') {
-      break;
+  // Returns the next space separated field, or an empty one at the end.
+  const auto next_field = [&]() {
+    while (pos < fen.size() && fen[pos] == ' ') {
+      pos++;
     }
-    else {
-      // Already at en passent, rewind.
-      chars_read--;
-      break;
+    const size_t start = pos;
+    while (pos < fen.size() && fen[pos] != ' ') {
+      pos++;
     }
+    return fen.substr(start, pos - start);
+  };
+
+  // Side to move.
+  const std::string_view side = next_field();
+  if (side != "w" && side != "b") {
+    return FenError::BAD_SIDE_TO_MOVE;
   }
-  if (board.castling[0] & Castling::KINGSIDE) {
-    board.kingside_rook_start_file = RookPosition(board, Castling::KINGSIDE, 0);
-  }
-  else if(board.castling[1] & Castling::KINGSIDE) {
-    board.kingside_rook_start_file = RookPosition(board, Castling::KINGSIDE, 7);
-  }
-  if (board.castling[0] & Castling::QUEENSIDE) {
-    board.queenside_rook_start_file = RookPosition(board, Castling::QUEENSIDE, 0);
+  board.white_to_move = side == "w";
+
+  // Castling priviliges.
+  const std::string_view castling = next_field();
+  if (castling.empty()) {
+    return FenError::BAD_CASTLING;
+  }
+  if (castling != "-") {
+    for (const char c : castling) {
+      const int color = std::islower(static_cast<unsigned char>(c)) ? 1 : 0;
+      const char wing = std::tolower(static_cast<unsigned char>(c));
+      if (wing == 'k') {
+        board.castling[color] = board.castling[color] | Castling::KINGSIDE;
+      }
+      else if (wing == 'q') {
+        board.castling[color] = board.castling[color] | Castling::QUEENSIDE;
+      }
+      else {
+        return FenError::BAD_CASTLING;
+      }
+    }
   }
-  else if(board.castling[1] & Castling::QUEENSIDE) {
-    board.queenside_rook_start_file = RookPosition(board, Castling::QUEENSIDE, 7);
+  board.FindRookStartFiles();
+  if (!board.HasCastlingRooks()) {
+    return FenError::BAD_CASTLING;
   }
 
-  // En passént
-  SquareIndex en_passent;
-  chars_read++;
-  if (fen.at(chars_read) == '-') {
-    board.en_passent = std::nullopt;
-    chars_read++;
+  // En passént, behind a pawn of the side that just moved.
+  const std::string_view en_passent = next_field();
+  if (en_passent.size() == 2 &&
+      'a' <= en_passent[0] && en_passent[0] <= 'h' &&
+      en_passent[1] == (board.white_to_move ? '6' : '3')) {
+    board.en_passent = SquareIndex{
+      .file = static_cast<int8_t>(en_passent[0] - 'a'),
+      .rank = static_cast<int8_t>(en_passent[1] - '1'),
+    };
   }
-  else {
-    SquareIndex en_passent;
-    en_passent.file = fen.at(chars_read++) - 'a';
-    en_passent.rank = fen.at(chars_read++) - '0';
-    board.en_passent = en_passent;
+  else if (en_passent != "-") {
+    return FenError::BAD_EN_PASSANT;
   }
 
-  // Move clocks.
-  std::string clock;
-  while (fen.at(++chars_read) != ' ') {
-    clock.push_back(fen.at(chars_read));
+  // Move clocks, which are often left out, e.g. in EPD.
+  board.halfmove_clock = 0;
+  board.fullmove_clock = 1;
+  for (int* clock : {&board.halfmove_clock, &board.fullmove_clock}) {
+    const std::string_view field = next_field();
+    if (field.empty()) {
+      break;
+    }
+    if (field.size() > 9) {
+      return FenError::BAD_CLOCK;
+    }
+    int value = 0;
+    for (const char c : field) {
+      if (c < '0' || c > '9') {
+        return FenError::BAD_CLOCK;
+      }
+      value = value * 10 + (c - '0');
+    }
+    *clock = value;
   }
-  board.halfmove_clock = stoi(clock);
 
-  clock.clear();
-  while (++chars_read < fen.size()) {
-    clock.push_back(fen.at(chars_read));
+  if (!next_field().empty()) {
+    return FenError::TRAILING_CHARACTERS;
   }
-  board.fullmove_clock = stoi(clock);
+  return FenError::OK;
+}
 
+Board Board::FromFEN(const std::string& fen) {
+  Board board;
+  const FenError error = ParseFEN(fen, board);
+  if (error != FenError::OK) {
+    throw std::invalid_argument(FenErrorMessage(error));
+  }
   return board;
 }
 
-std::string Board::ToFEN() const {
-  std::string output;
-  output.reserve(64);
+size_t Board::ToFEN(char* buffer) const {
+  char* output = buffer;
 
   // Write piece positions
   for (int rank = 7; rank >= 0; rank--) {
@@ -322,92 +518,169 @@ std::string Board::ToFEN() const {
     for (int file = 0; file < 8; file++) {
       if (this->squares[rank][file] == Piece::EMPTY) {
         empty_count++;
+        continue;
       }
-      else if (empty_count > 0) {
-        output.push_back('0' + empty_count);
+      if (empty_count > 0) {
+        *output++ = '0' + empty_count;
         empty_count = 0;
       }
-
-      const bool is_white = this->squares[rank][file] & Piece::IS_WHITE;
-      const int add_case = is_white ? 'A' - 'a' : 0;
-
-      if (this->squares[rank][file] & Piece::PAWN) {
-        output.push_back('p' + add_case);
-      }
-      else if (this->squares[rank][file] & Piece::KNIGHT) {
-        output.push_back('n' + add_case);
-      }
-      else if (this->squares[rank][file] & Piece::BISHOP) {
-        output.push_back('b' + add_case);
-      }
-      else if (this->squares[rank][file] & Piece::ROOK) {
-        output.push_back('r' + add_case);
-      }
-      else if (this->squares[rank][file] & Piece::QUEEN) {
-        output.push_back('q' + add_case);
-      }
-      else if (this->squares[rank][file] & Piece::KING) {
-        output.push_back('k' + add_case);
-      }
+      *output++ = PieceToChar(this->squares[rank][file]);
     }
     if (empty_count > 0) {
-      output.push_back('0' + empty_count);
+      *output++ = '0' + empty_count;
     }
     if (rank > 0) {
-      output.push_back('/');
+      *output++ = '/';
     }
   }
 
   // Side to move.
-  output.push_back(' ');
-  if (this->white_to_move) {
-    output.push_back('w');
-  }
-  else {
-    output.push_back('b');
-  }
+  *output++ = ' ';
+  *output++ = this->white_to_move ? 'w' : 'b';
 
   // Castling
+  *output++ = ' ';
   if (
-    this->castling[0] != Castling::NO_CASTLING ||
-    this->castling[1] != Castling::NO_CASTLING
+    this->castling[0] == Castling::NO_CASTLING &&
+    this->castling[1] == Castling::NO_CASTLING
   ) {
-    output.push_back(' ');
+    *output++ = '-';
   }
   if (this->castling[0] & Castling::KINGSIDE) {
-    output.push_back('K');
+    *output++ = 'K';
   }
   if (this->castling[0] & Castling::QUEENSIDE) {
-    output.push_back('Q');
+    *output++ = 'Q';
   }
   if (this->castling[1] & Castling::KINGSIDE) {
-    output.push_back('k');
+    *output++ = 'k';
   }
   if (this->castling[1] & Castling::QUEENSIDE) {
-    output.push_back('q');
+    *output++ = 'q';
   }
 
   // En passent
-  output.push_back(' ');
+  *output++ = ' ';
   if (this->en_passent.has_value()) {
-    output.push_back('a' + this->en_passent->file);
-    output.push_back('0' + this->en_passent->rank);
+    *output++ = 'a' + this->en_passent->file;
+    *output++ = '1' + this->en_passent->rank;
   }
-  else{
-    output.push_back('-');
+  else {
+    *output++ = '-';
   }
 
   // Clocks
-  std::string clock;
-  output.push_back(' ');
-  clock = std::to_string(this->halfmove_clock);
-  for (const char ch : clock) output.push_back(ch);
+  *output++ = ' ';
+  output = WriteNumber(output, this->halfmove_clock);
+  *output++ = ' ';
+  output = WriteNumber(output, this->fullmove_clock);
 
-  output.push_back(' ');
-  clock = std::to_string(this->fullmove_clock);
-  for (const char ch : clock) output.push_back(ch);
+  *output = '\0';
+  return output - buffer;
+}
 
-  return output;
+std::string Board::ToFEN() const {
+  char buffer[kMaxFENLength];
+  const size_t length = this->ToFEN(buffer);
+  return std::string(buffer, length);
+}
+
+bool Board::CanPack() const {
+  return __builtin_popcountll(this->Occupancy(true) | this->Occupancy(false)) <= 32;
+}
+
+PackedBoard Board::Pack() const {
+  PackedBoard packed = {};
+  const uint64_t occupancy = this->Occupancy(true) | this->Occupancy(false);
+  if (__builtin_popcountll(occupancy) > 32) {
+    throw std::invalid_argument("too many pieces to pack");
+  }
+  for (int i = 0; i < 8; i++) {
+    packed.bytes[i] = occupancy >> (i * 8);
+  }
+
+  int count = 0;
+  for (uint64_t remaining = occupancy; remaining != 0; remaining &= remaining - 1) {
+    const Piece piece = this->Squares()[__builtin_ctzll(remaining)];
+    packed.bytes[8 + count / 2] |= PieceCode(piece) << (count % 2 * 4);
+    count++;
+  }
+
+  packed.bytes[24] = (
+    (this->white_to_move ? 1 : 0) |
+    (this->castling[0] & Castling::KINGSIDE ? 2 : 0) |
+    (this->castling[0] & Castling::QUEENSIDE ? 4 : 0) |
+    (this->castling[1] & Castling::KINGSIDE ? 8 : 0) |
+    (this->castling[1] & Castling::QUEENSIDE ? 16 : 0));
+  packed.bytes[25] = this->en_passent.has_value() ? this->en_passent->file : 0xFF;
+  packed.bytes[26] = std::clamp(this->halfmove_clock, 0, 0xFF);
+  const int fullmove = std::clamp(this->fullmove_clock, 0, 0xFFFF);
+  packed.bytes[27] = fullmove & 0xFF;
+  packed.bytes[28] = fullmove >> 8;
+  return packed;
+}
+
+bool Board::Unpack(const PackedBoard& packed, Board& board) {
+  memset(board.squares, 0, sizeof(board.squares));
+  uint64_t occupancy = 0;
+  for (int i = 0; i < 8; i++) {
+    occupancy |= static_cast<uint64_t>(packed.bytes[i]) << (i * 8);
+  }
+  if (__builtin_popcountll(occupancy) > 32) {
+    return false;
+  }
+
+  int count = 0;
+  int kings[2] = {0, 0};
+  for (; occupancy != 0; occupancy &= occupancy - 1) {
+    const int square = __builtin_ctzll(occupancy);
+    const Piece piece = PieceFromCode(packed.bytes[8 + count / 2] >> (count % 2 * 4) & 0xF);
+    const int8_t rank = square / 8;
+    const int8_t file = square % 8;
+    if (piece == Piece::EMPTY || ((piece & Piece::PAWN) && (rank == 0 || rank == 7))) {
+      return false;
+    }
+    board.squares[rank][file] = piece;
+    if (piece & Piece::KING) {
+      const bool is_white = piece & Piece::IS_WHITE;
+      kings[!is_white]++;
+      board.kings_position[!is_white] = {.file = file, .rank = rank};
+    }
+    count++;
+  }
+  if (kings[0] != 1 || kings[1] != 1) {
+    return false;
+  }
+
+  const uint8_t flags = packed.bytes[24];
+  board.white_to_move = flags & 1;
+  board.castling[0] = (
+    (flags & 2 ? Castling::KINGSIDE : Castling::NO_CASTLING) |
+    (flags & 4 ? Castling::QUEENSIDE : Castling::NO_CASTLING));
+  board.castling[1] = (
+    (flags & 8 ? Castling::KINGSIDE : Castling::NO_CASTLING) |
+    (flags & 16 ? Castling::QUEENSIDE : Castling::NO_CASTLING));
+  board.FindRookStartFiles();
+  if (!board.HasCastlingRooks()) {
+    return false;
+  }
+
+  if (packed.bytes[25] == 0xFF) {
+    board.en_passent = std::nullopt;
+  }
+  else if (packed.bytes[25] < 8) {
+    // The en passant square is behind the pawn that just moved.
+    board.en_passent = SquareIndex{
+      .file = static_cast<int8_t>(packed.bytes[25]),
+      .rank = static_cast<int8_t>(board.white_to_move ? 5 : 2),
+    };
+  }
+  else {
+    return false;
+  }
+  board.halfmove_clock = packed.bytes[26];
+  board.fullmove_clock = packed.bytes[27] | packed.bytes[28] << 8;
+  return true;
 }
 
 void Board::Print(std::ostream& stream) const {
@@ -0,0 +1,394 @@
+#include "coordinator.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "board.h"
+#include "json.h"
+#include "moves.h"
+#include "search.h"
+#include "socket.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Interval at which a connection waiting for a response checks whether its
+// task has meanwhile been completed by another worker.
+constexpr int kPollInterval = 100;
+
+struct Task {
+  std::string fen;
+  SearchLimits limits;
+};
+
+// Hands out tasks to connections and collects their results. A task whose
+// connection fails is put back in front of the queue. Once the queue is
+// empty, idle connections run a second copy of the oldest running task, so
+// that a slow worker cannot hold up the end of the job; the first result
+// wins.
+class Scheduler {
+ public:
+  Scheduler(size_t num_tasks, int num_connections, std::ostream* log)
+    : results(num_tasks), runners(num_tasks, 0), started(num_tasks),
+      remaining(num_tasks), live_connections(num_connections), log(log) {
+    for (size_t i = 0; i < num_tasks; i++) {
+      this->pending.push_back(i);
+    }
+  }
+
+  // Returns the next task to run, or nothing once all tasks are done.
+  std::optional<size_t> Next() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (this->remaining > 0) {
+      if (!this->pending.empty()) {
+        const size_t index = this->pending.front();
+        this->pending.pop_front();
+        this->Start(index);
+        return index;
+      }
+      std::optional<size_t> oldest;
+      for (size_t i = 0; i < this->results.size(); i++) {
+        if (!this->results[i].has_value() && this->runners[i] == 1 &&
+            (!oldest.has_value() || this->started[i] < this->started[*oldest])) {
+          oldest = i;
+        }
+      }
+      if (oldest.has_value()) {
+        this->Start(*oldest);
+        return oldest;
+      }
+      this->changed.wait(lock);
+    }
+    return std::nullopt;
+  }
+
+  // Whether the task needs no more work, because it is done or the job
+  // was aborted.
+  bool IsDone(size_t index) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->results[index].has_value() || this->remaining == 0;
+  }
+
+  void Complete(size_t index, const JsonObject& result, const std::string& worker) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->runners[index]--;
+    if (this->results[index].has_value()) {
+      return;
+    }
+    this->results[index] = result;
+    this->remaining--;
+    if (this->log != nullptr) {
+      *this->log << "task " << index << " done by " << worker << ", "
+                 << this->remaining << " remaining" << std::endl;
+    }
+    this->changed.notify_all();
+  }
+
+  // Gives up a task started by Next() without a result.
+  void Return(size_t index) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->runners[index]--;
+    if (!this->results[index].has_value() && this->runners[index] == 0) {
+      this->pending.push_front(index);
+      this->changed.notify_all();
+    }
+  }
+
+  // Called when a connection has given up for good.
+  void ConnectionLost(const std::string& worker) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->live_connections--;
+    if (this->log != nullptr) {
+      *this->log << "lost connection to " << worker << std::endl;
+    }
+    this->changed.notify_all();
+  }
+
+  // Blocks until the task is done and returns its result. Throws if no
+  // connection is left to run it.
+  JsonObject WaitFor(size_t index) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->changed.wait(lock, [&]() {
+      return this->results[index].has_value() || this->live_connections == 0;
+    });
+    if (!this->results[index].has_value()) {
+      throw std::runtime_error("all workers failed");
+    }
+    return *this->results[index];
+  }
+
+  // Makes Next() return nothing, for when the results are no longer needed.
+  void Abort() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->remaining = 0;
+    this->changed.notify_all();
+  }
+
+ private:
+  void Start(size_t index) {
+    this->runners[index]++;
+    this->started[index] = Clock::now();
+  }
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<size_t> pending;
+  std::vector<std::optional<JsonObject>> results;
+  // Connections running each task, and when the last one started it.
+  std::vector<int> runners;
+  std::vector<Clock::time_point> started;
+  size_t remaining;
+  int live_connections;
+  std::ostream* log;
+};
+
+std::string RequestLine(const std::string& id, const Task& task, size_t hash_megabytes) {
+  std::ostringstream request;
+  request << "{\"id\":\"" << id << "\",\"fen\":\"" << JsonEscape(task.fen) << '"'
+          << ",\"depth\":" << task.limits.depth
+          << ",\"nodes\":" << task.limits.nodes
+          << ",\"fresh\":true,\"hash\":" << hash_megabytes << '}';
+  return request.str();
+}
+
+// Sends a task over the connection and waits for its response. Returns
+// nothing if the connection fails or the task times out.
+std::optional<JsonObject> Exchange(int fd, LineReader& reader, const std::string& id,
+                                   const Task& task, size_t index, Scheduler& scheduler,
+                                   const CoordinatorOptions& options) {
+  if (!SendAll(fd, RequestLine(id, task, options.hash_megabytes) + "\n")) {
+    return std::nullopt;
+  }
+  const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(options.task_timeout);
+  bool cancelled = false;
+  while (Clock::now() < deadline) {
+    std::string line;
+    if (!reader.ReadLine(line, kPollInterval)) {
+      if (reader.Closed()) {
+        return std::nullopt;
+      }
+      if (!cancelled && scheduler.IsDone(index)) {
+        // Another worker was faster, free this one for the next task.
+        cancelled = SendAll(fd, "{\"cancel\":\"" + id + "\"}\n");
+      }
+      continue;
+    }
+    JsonObject response;
+    if (ParseJsonObject(line, response) && response["id"] == id) {
+      return response;
+    }
+  }
+  return std::nullopt;
+}
+
+// Runs tasks over one connection to a worker until all are done, or the
+// worker keeps failing.
+void RunConnection(const std::string& worker, const std::vector<Task>& tasks,
+                   Scheduler& scheduler, const CoordinatorOptions& options) {
+  int fd = -1;
+  std::unique_ptr<LineReader> reader;
+  int failures = 0;
+  uint64_t next_id = 0;
+
+  const auto fail = [&](size_t index) {
+    scheduler.Return(index);
+    if (fd >= 0) {
+      // Closing the connection makes the worker cancel the task.
+      close(fd);
+      fd = -1;
+    }
+    failures++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100 * failures));
+  };
+
+  while (failures <= options.max_retries) {
+    const std::optional<size_t> index = scheduler.Next();
+    if (!index.has_value()) {
+      break;
+    }
+    if (fd < 0) {
+      try {
+        fd = ConnectTo(worker);
+        reader = std::make_unique<LineReader>(fd);
+      }
+      catch (const std::runtime_error&) {
+        fail(*index);
+        continue;
+      }
+    }
+
+    // Ids are unique per connection, so that a late response to a task
+    // given up on is never taken for the response to the next one.
+    const std::string id = std::to_string(next_id++);
+    std::optional<JsonObject> response = Exchange(
+      fd, *reader, id, tasks[*index], *index, scheduler, options);
+    if (!response.has_value()) {
+      fail(*index);
+      continue;
+    }
+    const auto error_it = response->find("error");
+    const std::string error = error_it == response->end() ? "" : error_it->second;
+    if (error == "busy" || error == "cancelled" || error == "deadline exceeded") {
+      scheduler.Return(*index);
+      if (error == "busy") {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kPollInterval));
+      }
+      continue;
+    }
+    scheduler.Complete(*index, *response, worker);
+    failures = 0;
+  }
+
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (failures > options.max_retries) {
+    scheduler.ConnectionLost(worker);
+  }
+}
+
+// Runs the tasks on the workers, passing each result to `consume` in task
+// order as soon as it and all results before it are available.
+template <typename Consume>
+void RunTasks(const std::vector<Task>& tasks, const CoordinatorOptions& options,
+              const Consume& consume) {
+  const int connections_per_worker = std::max(options.connections, 1);
+  const int num_connections = static_cast<int>(options.workers.size()) * connections_per_worker;
+  if (num_connections == 0) {
+    throw std::runtime_error("no workers");
+  }
+  Scheduler scheduler(tasks.size(), num_connections, options.log);
+  std::vector<std::thread> connections;
+  for (const std::string& worker : options.workers) {
+    for (int i = 0; i < connections_per_worker; i++) {
+      connections.emplace_back([&, worker]() {
+        RunConnection(worker, tasks, scheduler, options);
+      });
+    }
+  }
+
+  try {
+    for (size_t i = 0; i < tasks.size(); i++) {
+      consume(i, scheduler.WaitFor(i));
+    }
+  }
+  catch (...) {
+    scheduler.Abort();
+    for (std::thread& connection : connections) {
+      connection.join();
+    }
+    throw;
+  }
+  for (std::thread& connection : connections) {
+    connection.join();
+  }
+}
+
+}  // namespace
+
+uint64_t CoordinateBatch(std::istream& input, std::ostream& output,
+                         const CoordinatorOptions& options) {
+  BatchOptions defaults;
+  defaults.depth = options.depth;
+  defaults.nodes = options.nodes;
+  std::vector<Task> tasks;
+  std::string line;
+  while (std::getline(input, line)) {
+    Task task;
+    if (ParseBatchLine(line, defaults, task.fen, task.limits)) {
+      tasks.push_back(task);
+    }
+  }
+
+  RunTasks(tasks, options, [&](size_t index, const JsonObject& result) {
+    // Only fields that do not depend on the worker, such as the time taken.
+    output << "{\"fen\":\"" << JsonEscape(tasks[index].fen) << '"';
+    if (result.count("error") != 0) {
+      output << ",\"error\":\"" << JsonEscape(result.at("error")) << '"';
+    }
+    else {
+      output << ",\"score\":" << result.at("score")
+             << ",\"best_move\":\"" << JsonEscape(result.at("best_move")) << '"'
+             << ",\"pv\":\"" << JsonEscape(result.at("pv")) << '"'
+             << ",\"depth\":" << result.at("depth")
+             << ",\"nodes\":" << result.at("nodes");
+    }
+    output << "}\n";
+  });
+  output.flush();
+  return tasks.size();
+}
+
+SearchResult CoordinateSearch(const Board& board, int depth, const CoordinatorOptions& options) {
+  if (depth <= 1) {
+    // The moves are only scored by the evaluation, nothing to distribute.
+    Search search(options.hash_megabytes);
+    SearchLimits limits;
+    limits.depth = 1;
+    limits.nodes = options.nodes;
+    return search.Run(board, limits);
+  }
+  std::vector<Move> moves;
+  std::vector<Task> tasks;
+  MoveIterator iterator(board);
+  while (const std::optional<Move> move = iterator.Next(true, true, true)) {
+    Task task;
+    task.fen = iterator.CurrentPosition()->ToFEN();
+    task.limits.depth = depth - 1;
+    task.limits.nodes = options.nodes;
+    moves.push_back(*move);
+    tasks.push_back(task);
+  }
+  if (moves.empty()) {
+    // Mate or stalemate, nothing to distribute.
+    Search search(1);
+    SearchLimits limits;
+    return search.Run(board, limits);
+  }
+
+  const bool white_to_move = board.WhiteToMove();
+  SearchResult best;
+  best.depth = depth;
+  best.nodes = 1;
+  RunTasks(tasks, options, [&](size_t index, const JsonObject& result) {
+    if (result.count("error") != 0) {
+      throw std::runtime_error("worker failed on " + tasks[index].fen + ": " + result.at("error"));
+    }
+    const int score = std::stoi(result.at("score"));
+    best.nodes += std::stoull(result.at("nodes"));
+    if (best.best_move.has_value() && (white_to_move ? score <= best.score : score >= best.score)) {
+      return;
+    }
+    best.score = score;
+    best.best_move = moves[index];
+    best.pv = {moves[index]};
+    Board position = board;
+    position.Move(moves[index].from, moves[index].to, moves[index].promotion,
+                  moves[index].castling);
+    std::istringstream pv(result.at("pv"));
+    std::string text;
+    while (pv >> text) {
+      const std::optional<Move> move = MoveFromString(position, text);
+      if (!move.has_value()) {
+        break;
+      }
+      position.Move(move->from, move->to, move->promotion, move->castling);
+      best.pv.push_back(*move);
+    }
+  });
+  return best;
+}
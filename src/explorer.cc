@@ -0,0 +1,402 @@
+#include "explorer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "mapped_file.h"
+#include "moves.h"
+#include "pgn.h"
+#include "pieces.h"
+
+namespace {
+
+// Records written per fwrite() call.
+constexpr size_t kWriteBuffer = 4096;
+
+bool RecordLess(const ExplorerRecord& lhs, const ExplorerRecord& rhs) {
+  return std::tie(lhs.key, lhs.move) < std::tie(rhs.key, rhs.move);
+}
+
+// Adds the counts of `from` to `to`, saturating instead of overflowing.
+void AddCounts(ExplorerRecord& to, const ExplorerRecord& from) {
+  const auto add = [](uint32_t a, uint32_t b) {
+    return a > UINT32_MAX - b ? UINT32_MAX : a + b;
+  };
+  to.white_wins = add(to.white_wins, from.white_wins);
+  to.draws = add(to.draws, from.draws);
+  to.black_wins = add(to.black_wins, from.black_wins);
+}
+
+// Board::Hash() covers the en passant square after every double pawn
+// push. Positions reached with and without one must share their records
+// when no pawn can capture en passant, as in FEN strings that leave the
+// square out.
+uint64_t ExplorerKey(const Board& board) {
+  const std::optional<SquareIndex> en_passant = board.EnPassantSquare();
+  if (!en_passant.has_value()) {
+    return board.Hash();
+  }
+  const bool white = board.WhiteToMove();
+  const int8_t rank = white ? en_passant->rank - 1 : en_passant->rank + 1;
+  const Piece pawn = white ? Piece::PAWN | Piece::IS_WHITE : Piece::PAWN;
+  for (const int8_t file : {en_passant->file - 1, en_passant->file + 1}) {
+    if (file >= 0 && file < 8 && board.Get(file, rank) == pawn) {
+      return board.Hash();
+    }
+  }
+  Board without = board;
+  without.ClearEnPassant();
+  return without.Hash();
+}
+
+// Sorts the records and merges those of the same position and move.
+void SortAndMerge(std::vector<ExplorerRecord>& records) {
+  std::sort(records.begin(), records.end(), RecordLess);
+  size_t size = 0;
+  for (const ExplorerRecord& record : records) {
+    if (size > 0 && records[size - 1].key == record.key && records[size - 1].move == record.move) {
+      AddCounts(records[size - 1], record);
+    }
+    else {
+      records[size++] = record;
+    }
+  }
+  records.resize(size);
+}
+
+// Writes records to a file, buffering writes. Failures are sticky and
+// reported by Close().
+class RecordWriter {
+ public:
+  // Creates the file and writes the header of an index, if `header` is set.
+  RecordWriter(const std::string& path, bool header)
+    : path(path), file(fopen(path.c_str(), "wb")), header(header) {
+    if (this->file == nullptr) {
+      throw std::runtime_error("cannot create " + path + ": " + strerror(errno));
+    }
+    if (header) {
+      // The count is filled in by Close().
+      const uint8_t count[8] = {};
+      fwrite(kExplorerFileMagic, sizeof(kExplorerFileMagic), 1, this->file);
+      fwrite(count, sizeof(count), 1, this->file);
+    }
+    this->buffer.reserve(kWriteBuffer);
+  }
+
+  ~RecordWriter() {
+    if (this->file != nullptr) {
+      fclose(this->file);
+    }
+  }
+
+  RecordWriter(const RecordWriter&) = delete;
+  RecordWriter& operator=(const RecordWriter&) = delete;
+
+  void Write(const ExplorerRecord& record) {
+    this->buffer.push_back(record);
+    this->count++;
+    if (this->buffer.size() == kWriteBuffer) {
+      this->Flush();
+    }
+  }
+
+  // Throws std::runtime_error if writing failed.
+  void Close() {
+    this->Flush();
+    if (this->header && fseek(this->file, sizeof(kExplorerFileMagic), SEEK_SET) == 0) {
+      uint8_t count[8];
+      for (int i = 0; i < 8; i++) {
+        count[i] = static_cast<uint8_t>(this->count >> (8 * i));
+      }
+      fwrite(count, sizeof(count), 1, this->file);
+    }
+    const bool failed = ferror(this->file) != 0;
+    const bool close_failed = fclose(this->file) != 0;
+    this->file = nullptr;
+    if (failed || close_failed) {
+      throw std::runtime_error("cannot write " + this->path);
+    }
+  }
+
+  uint64_t Count() const {
+    return this->count;
+  }
+
+ private:
+  void Flush() {
+    if (!this->buffer.empty()) {
+      fwrite(this->buffer.data(), sizeof(ExplorerRecord), this->buffer.size(), this->file);
+      this->buffer.clear();
+    }
+  }
+
+  const std::string path;
+  FILE* file;
+  const bool header;
+  std::vector<ExplorerRecord> buffer;
+  uint64_t count = 0;
+};
+
+// Merges sorted run files into the index, merging the counts of records
+// that occur in several runs.
+uint64_t MergeRuns(const std::vector<std::string>& runs, const std::string& path) {
+  std::vector<MappedFile> files;
+  for (const std::string& run : runs) {
+    files.emplace_back(run);
+  }
+
+  // Positions in the runs, ordered by their current record.
+  using Cursor = std::pair<const ExplorerRecord*, const ExplorerRecord*>;
+  const auto greater = [](const Cursor& lhs, const Cursor& rhs) {
+    return RecordLess(*rhs.first, *lhs.first);
+  };
+  std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heap(greater);
+  for (const MappedFile& file : files) {
+    const auto* begin = reinterpret_cast<const ExplorerRecord*>(file.Data());
+    const auto* end = begin + file.Size() / sizeof(ExplorerRecord);
+    if (begin != end) {
+      heap.push({begin, end});
+    }
+  }
+
+  RecordWriter writer(path, true);
+  bool pending = false;
+  ExplorerRecord current;
+  while (!heap.empty()) {
+    Cursor cursor = heap.top();
+    heap.pop();
+    const ExplorerRecord& record = *cursor.first;
+    if (pending && current.key == record.key && current.move == record.move) {
+      AddCounts(current, record);
+    }
+    else {
+      if (pending) {
+        writer.Write(current);
+      }
+      current = record;
+      pending = true;
+    }
+    if (++cursor.first != cursor.second) {
+      heap.push(cursor);
+    }
+  }
+  if (pending) {
+    writer.Write(current);
+  }
+  writer.Close();
+  return writer.Count();
+}
+
+// Collects records from the games replayed by the worker threads, and
+// writes them to sorted run files whenever too many have accumulated.
+class RunCollector {
+ public:
+  RunCollector(const std::string& path, size_t run_records)
+    : path(path), run_records(std::max<size_t>(run_records, 1)) {}
+
+  ~RunCollector() {
+    for (const std::string& run : this->runs) {
+      std::remove(run.c_str());
+    }
+  }
+
+  void Add(std::vector<ExplorerRecord>& records) {
+    std::vector<ExplorerRecord> full;
+    std::string run;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->records.insert(this->records.end(), records.begin(), records.end());
+      if (this->records.size() < this->run_records) {
+        return;
+      }
+      full.swap(this->records);
+      run = this->path + ".run" + std::to_string(this->runs.size());
+      this->runs.push_back(run);
+    }
+    // Sorted and written outside the lock, so that other workers can go
+    // on replaying games.
+    SortAndMerge(full);
+    RecordWriter writer(run, false);
+    for (const ExplorerRecord& record : full) {
+      writer.Write(record);
+    }
+    writer.Close();
+  }
+
+  // Writes the index. Returns the number of records and of runs merged.
+  std::pair<uint64_t, size_t> Finish() {
+    SortAndMerge(this->records);
+    if (this->runs.empty()) {
+      RecordWriter writer(this->path, true);
+      for (const ExplorerRecord& record : this->records) {
+        writer.Write(record);
+      }
+      writer.Close();
+      return {writer.Count(), 0};
+    }
+    if (!this->records.empty()) {
+      const std::string run = this->path + ".run" + std::to_string(this->runs.size());
+      this->runs.push_back(run);
+      RecordWriter writer(run, false);
+      for (const ExplorerRecord& record : this->records) {
+        writer.Write(record);
+      }
+      writer.Close();
+      this->records = std::vector<ExplorerRecord>();
+    }
+    return {MergeRuns(this->runs, this->path), this->runs.size()};
+  }
+
+ private:
+  const std::string path;
+  const size_t run_records;
+  std::mutex mutex;
+  std::vector<ExplorerRecord> records;
+  std::vector<std::string> runs;
+};
+
+}  // namespace
+
+ExplorerBuildStats BuildExplorer(std::istream& games, const std::string& path,
+                                 const ExplorerBuildOptions& options,
+                                 const PgnProgress& progress) {
+  RunCollector collector(path, options.run_records);
+  // The first error of a worker, rethrown once all games are read.
+  std::mutex error_mutex;
+  std::string error;
+
+  ExplorerBuildStats stats;
+  stats.games = ReplayPgn(games, options.pgn, [&](const PgnGame& game) {
+    ExplorerRecord result = {};
+    if (game.result == "1-0") {
+      result.white_wins = 1;
+    }
+    else if (game.result == "0-1") {
+      result.black_wins = 1;
+    }
+    else if (game.result == "1/2-1/2") {
+      result.draws = 1;
+    }
+    else {
+      // Unfinished games tell nothing about the moves played.
+      return;
+    }
+
+    std::vector<ExplorerRecord> records;
+    Board board = game.start;
+    const size_t plies = std::min<size_t>(game.moves.size(), std::max(options.max_plies, 0));
+    for (size_t i = 0; i < plies; i++) {
+      const Move& move = game.moves[i];
+      ExplorerRecord record = result;
+      record.key = ExplorerKey(board);
+      record.move = PackMove(move);
+      records.push_back(record);
+      board.Move(move.from, move.to, move.promotion, move.castling);
+    }
+    try {
+      collector.Add(records);
+    }
+    catch (const std::runtime_error& exception) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (error.empty()) {
+        error = exception.what();
+      }
+    }
+  }, progress);
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+
+  std::tie(stats.records, stats.runs) = collector.Finish();
+  return stats;
+}
+
+OpeningExplorer::OpeningExplorer(const std::string& path) : file(path) {
+  constexpr size_t header = sizeof(kExplorerFileMagic) + 8;
+  if (this->file.Size() < header ||
+      memcmp(this->file.Data(), kExplorerFileMagic, sizeof(kExplorerFileMagic)) != 0) {
+    throw std::runtime_error(path + " is not an explorer index");
+  }
+  uint64_t count = 0;
+  for (int i = 0; i < 8; i++) {
+    count |= static_cast<uint64_t>(static_cast<uint8_t>(
+      this->file.Data()[sizeof(kExplorerFileMagic) + i])) << (8 * i);
+  }
+  if (count > (this->file.Size() - header) / sizeof(ExplorerRecord)) {
+    throw std::runtime_error(path + " is truncated");
+  }
+  // Mappings are page aligned, so the records after the 16-byte header
+  // are aligned as well.
+  this->records = reinterpret_cast<const ExplorerRecord*>(this->file.Data() + header);
+  this->count = count;
+}
+
+size_t OpeningExplorer::LowerBound(uint64_t key) const {
+  // Keys are hashes, spread evenly over their range, so interpolating
+  // finds the position in a few probes on average. Every other probe
+  // bisects, so that uneven keys can not make the search linear.
+  size_t low = 0;
+  size_t high = this->count;
+  for (bool bisect = false; high - low > 8; bisect = !bisect) {
+    const uint64_t low_key = this->records[low].key;
+    const uint64_t high_key = this->records[high - 1].key;
+    if (key <= low_key) {
+      return low;
+    }
+    if (key > high_key) {
+      return high;
+    }
+    size_t middle;
+    if (bisect) {
+      middle = low + (high - low) / 2;
+    }
+    else {
+      const double fraction = static_cast<double>(key - low_key) / static_cast<double>(high_key - low_key);
+      middle = low + static_cast<size_t>(fraction * (high - 1 - low));
+      middle = std::min(middle, high - 1);
+    }
+    if (this->records[middle].key < key) {
+      low = middle + 1;
+    }
+    else {
+      high = middle;
+    }
+  }
+  while (low < high && this->records[low].key < key) {
+    low++;
+  }
+  return low;
+}
+
+std::vector<ExplorerMove> OpeningExplorer::Lookup(const Board& board) const {
+  const uint64_t key = ExplorerKey(board);
+  std::vector<ExplorerMove> moves;
+  for (size_t i = this->LowerBound(key); i < this->count && this->records[i].key == key; i++) {
+    const ExplorerRecord& record = this->records[i];
+    ExplorerMove move;
+    move.move = UnpackMove(record.move);
+    // Positions with the same hash may share records.
+    if (!IsLegal(board, move.move)) {
+      continue;
+    }
+    move.white_wins = record.white_wins;
+    move.draws = record.draws;
+    move.black_wins = record.black_wins;
+    moves.push_back(move);
+  }
+  std::stable_sort(moves.begin(), moves.end(), [](const ExplorerMove& lhs, const ExplorerMove& rhs) {
+    return lhs.Games() > rhs.Games();
+  });
+  return moves;
+}
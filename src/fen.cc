@@ -0,0 +1,32 @@
+#include "fen.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "mapped_file.h"
+
+size_t ParseFENLines(std::string_view text, std::vector<Board>& boards) {
+  // One allocation for the whole text, assuming one position per line.
+  boards.reserve(boards.size() + std::count(text.begin(), text.end(), '\n') + 1);
+
+  size_t malformed = 0;
+  Board board;
+  ForEachLine(text, [&](std::string_view line) {
+    if (Board::ParseFEN(line, board) == FenError::OK) {
+      boards.push_back(board);
+    }
+    else {
+      malformed++;
+    }
+  });
+  return malformed;
+}
+
+size_t LoadFENFile(const std::string& path, std::vector<Board>& boards) {
+  const MappedFile file(path);
+  return ParseFENLines(file.View(), boards);
+}
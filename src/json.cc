@@ -0,0 +1,133 @@
+#include "json.h"
+
+#include <cctype>
+#include <map>
+#include <string>
+
+namespace {
+
+void SkipSpace(const std::string& text, size_t& pos) {
+  while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+    pos++;
+  }
+}
+
+// Reads a string literal starting at the opening quote.
+bool ParseString(const std::string& text, size_t& pos, std::string& value) {
+  if (pos >= text.size() || text[pos] != '"') {
+    return false;
+  }
+  value.clear();
+  for (pos++; pos < text.size(); pos++) {
+    char c = text[pos];
+    if (c == '"') {
+      pos++;
+      return true;
+    }
+    if (c == '\\') {
+      if (++pos >= text.size()) {
+        return false;
+      }
+      switch (text[pos]) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'u':
+          // Only needed for control characters, which never occur in
+          // positions or moves.
+          if (pos + 4 >= text.size()) {
+            return false;
+          }
+          for (size_t i = pos + 1; i <= pos + 4; i++) {
+            if (!std::isxdigit(static_cast<unsigned char>(text[i]))) {
+              return false;
+            }
+          }
+          c = static_cast<char>(std::stoi(text.substr(pos + 1, 4), nullptr, 16));
+          pos += 4;
+          break;
+        default: c = text[pos]; break;
+      }
+    }
+    value.push_back(c);
+  }
+  return false;
+}
+
+}  // namespace
+
+std::string JsonEscape(const std::string& text) {
+  std::string output;
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      output.push_back('\\');
+      output.push_back(c);
+    }
+    else if (static_cast<unsigned char>(c) < 0x20) {
+      output.push_back(' ');
+    }
+    else {
+      output.push_back(c);
+    }
+  }
+  return output;
+}
+
+bool ParseJsonObject(const std::string& text, JsonObject& object) {
+  object.clear();
+  size_t pos = 0;
+  SkipSpace(text, pos);
+  if (pos >= text.size() || text[pos++] != '{') {
+    return false;
+  }
+  SkipSpace(text, pos);
+  if (pos < text.size() && text[pos] == '}') {
+    pos++;
+  }
+  else {
+    while (true) {
+      std::string key;
+      SkipSpace(text, pos);
+      if (!ParseString(text, pos, key)) {
+        return false;
+      }
+      SkipSpace(text, pos);
+      if (pos >= text.size() || text[pos++] != ':') {
+        return false;
+      }
+      SkipSpace(text, pos);
+      std::string value;
+      if (pos < text.size() && text[pos] == '"') {
+        if (!ParseString(text, pos, value)) {
+          return false;
+        }
+      }
+      else {
+        const size_t start = pos;
+        while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) ||
+                                     text[pos] == '-' || text[pos] == '+' || text[pos] == '.')) {
+          pos++;
+        }
+        if (pos == start) {
+          return false;
+        }
+        value = text.substr(start, pos - start);
+      }
+      object[key] = value;
+      SkipSpace(text, pos);
+      if (pos < text.size() && text[pos] == ',') {
+        pos++;
+        continue;
+      }
+      if (pos < text.size() && text[pos] == '}') {
+        pos++;
+        break;
+      }
+      return false;
+    }
+  }
+  SkipSpace(text, pos);
+  return pos == text.size();
+}
@@ -1,123 +1,699 @@
+#include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
 #include <iostream>
-#include <tuple>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include "batch.h"
+#include "bench.h"
+#include "bitbase.h"
 #include "board.h"
+#include "coordinator.h"
 #include "evaluation.h"
+#include "explorer.h"
+#include "fen.h"
+#include "mapped_file.h"
+#include "match.h"
 #include "moves.h"
+#include "packed_file.h"
+#include "perft.h"
+#include "pgn.h"
 #include "pieces.h"
+#include "polyglot.h"
+#include "search.h"
+#include "server.h"
+#include "trace.h"
+#include "uci.h"
 
 namespace {
 
-SquareIndex GetUncastledKingPos(const Board& b, int8_t rank) {
-  for (int8_t file = 0; file < 8; file++) {
-    if (b.Get(file, rank) & Piece::KING) {
-      return {.file = file, .rank = rank};
+constexpr char kStartPosition[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// For debugging. Lists the moves, best first, with their scores from one
+// search of all moves.
+void PrintAvailableMoves(const Board& board) {
+  SearchLimits limits;
+  limits.depth = 8;
+  limits.multi_pv = std::numeric_limits<int>::max();
+  Search search;
+  for (const SearchLine& line : search.Run(board, limits).lines) {
+    const Move& move = line.move;
+    const int eval = line.score;
+    if (move.castling & Castling::KINGSIDE) {
+      std::cout << "o-o";
+    }
+    else if (move.castling & Castling::QUEENSIDE) {
+      std::cout << "o-o-o";
+    }
+    else {
+      std::cout << static_cast<char>(move.from.file + 'a') << move.from.rank + 1;
+      std::cout << static_cast<char>(move.to.file + 'a') << move.to.rank + 1;
+      if (move.promotion != Piece::EMPTY) {
+        if (move.promotion & Piece::QUEEN)
+          std::cout << "=q";
+        else if (move.promotion & Piece::KNIGHT)
+          std::cout << "=n";
+      }
     }
+    std::cout << " (" << eval << ") ";
   }
-  return {-1, -1};
+  std::cout << std::endl;
 }
 
-std::tuple<SquareIndex, SquareIndex, Castling, Piece> GetMove(const Board& b) {
-  std::string input;
-  getline(std::cin, input);
+// Measures the time to reach a fixed depth with an increasing number of
+// threads, on a fixed set of positions.
+void SmpBenchmark(int depth, int max_threads) {
+  const char* positions[] = {
+    kStartPosition,
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/5N2/PP2PPPP/RNBQKB1R w KQkq - 0 4",
+    "rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkb1r/pppppppp/5n2/8/2P5/8/PP1PPPPP/RNBQKBNR w KQkq - 1 2",
+  };
 
-  std::transform(input.begin(), input.end(), input.begin(),
-    [](signed char c){ return std::tolower(c); });
+  double single_thread_seconds = 0;
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    SearchLimits limits;
+    limits.depth = depth;
+    limits.threads = threads;
 
-  SquareIndex from;
-  SquareIndex to;
-  Castling castling = Castling::NO_CASTLING;
-  int8_t kings_rank = b.WhiteToMove() ? 0 : 7;
-  if (input == "o-o") {
-    castling = Castling::KINGSIDE;
-    from = GetUncastledKingPos(b, kings_rank);
-    to = {.file = 'g' - 'a', .rank = kings_rank};
-  }
-  else if(input == "o-o-o") {
-    castling = Castling::QUEENSIDE;
-    from = GetUncastledKingPos(b, kings_rank);
-    to = {.file = 'c' - 'a', .rank = kings_rank};
-  }
-  else {
-    from = {
-      .file = static_cast<int8_t>(input[0] - 'a'),
-      .rank = static_cast<int8_t>(input[1] - '1'),
-    };
-    to = {
-      .file = static_cast<int8_t>(input[2] - 'a'),
-      .rank = static_cast<int8_t>(input[3] - '1'),
-    };
+    uint64_t nodes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const char* fen : positions) {
+      Search search;
+      nodes += search.Run(Board::FromFEN(fen), limits).nodes;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (threads == 1) {
+      single_thread_seconds = elapsed.count();
+    }
+
+    std::cout << "threads " << threads
+              << " time " << elapsed.count() << "s"
+              << " speedup " << single_thread_seconds / elapsed.count()
+              << " nodes " << nodes
+              << " nps " << static_cast<uint64_t>(nodes / elapsed.count())
+              << std::endl;
   }
+}
 
-  Piece promotion = Piece::EMPTY;
-  if (castling == Castling::NO_CASTLING && input.size() > 4) {
-    Piece is_white = b.WhiteToMove() ? Piece::IS_WHITE : Piece::EMPTY;
-    if (input.at(4) == 'b') {
-      promotion = Piece::BISHOP | is_white;
+// Arguments of a subcommand: positional arguments, and `--name value` options.
+struct Arguments {
+  std::vector<std::string> positional;
+  std::map<std::string, std::string> options;
+
+  // Returns the number given for `name`, clamped to the range of `T`, or
+  // `fallback` if there is none. Malformed numbers are reported and ignored.
+  template <typename T>
+  T GetNumber(const std::string& name, T fallback) const {
+    const auto it = this->options.find(name);
+    if (it == this->options.end()) {
+      return fallback;
+    }
+    const std::string& value = it->second;
+    T number = 0;
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error == std::errc::result_out_of_range) {
+      return value[0] == '-' ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
     }
-    else if (input.at(4) == 'n') {
-      promotion = Piece::KNIGHT | is_white;
+    if (error != std::errc() || end != value.data() + value.size()) {
+      std::cerr << "Ignoring invalid value of --" << name << ": " << value << std::endl;
+      return fallback;
+    }
+    return number;
+  }
+  int GetInt(const std::string& name, int fallback) const {
+    return this->GetNumber<int>(name, fallback);
+  }
+  std::string Get(const std::string& name, const std::string& fallback) const {
+    const auto it = this->options.find(name);
+    return it == this->options.end() ? fallback : it->second;
+  }
+  // Joins the positional arguments from `first` on, e.g. a FEN string.
+  std::string Join(size_t first) const {
+    std::string joined;
+    for (size_t i = first; i < this->positional.size(); i++) {
+      joined += (joined.empty() ? "" : " ") + this->positional[i];
     }
-    else if (input.at(4) == 'r') {
-      promotion = Piece::ROOK | is_white;
+    return joined;
+  }
+};
+
+Arguments ParseArguments(int argc, char** argv, int first) {
+  Arguments arguments;
+  for (int i = first; i < argc; i++) {
+    if (strncmp(argv[i], "--", 2) == 0 && i + 1 < argc) {
+      arguments.options[argv[i] + 2] = argv[i + 1];
+      i++;
     }
-    else if (input.at(4) == 'q') {
-      promotion = Piece::QUEEN | is_white;
+    else {
+      arguments.positional.push_back(argv[i]);
     }
   }
+  return arguments;
+}
 
-  return {from, to, castling, promotion};
+int DefaultThreads() {
+  return std::max<int>(std::thread::hardware_concurrency(), 1);
 }
 
-// For debugging
-void PrintAvailableMoves(const Board& board) {
-  MoveIterator move_iter(board);
-  while (std::optional<Move> move = move_iter.Next(true, true, true)) {
-    const int eval = Evaluate(move_iter.CurrentPosition(), 7);
-    if (move->castling & Castling::KINGSIDE) {
-      std::cout << "o-o";
+// Prints the number of leaf nodes below each move, the total and the
+// throughput. Returns the total.
+uint64_t PerftDivide(const Board& board, int depth, const PerftOptions& options) {
+  const auto start = std::chrono::steady_clock::now();
+  const std::vector<DivideEntry> divide = ParallelPerft(board, depth, options);
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  uint64_t total = 0;
+  for (const DivideEntry& entry : divide) {
+    std::cout << MoveToString(entry.move) << ": " << entry.nodes << std::endl;
+    total += entry.nodes;
+  }
+  std::cout << std::endl
+            << "Nodes searched: " << total << std::endl
+            << "Time: " << elapsed.count() << "s" << std::endl
+            << "Nodes/second: " << static_cast<uint64_t>(total / elapsed.count()) << std::endl;
+  return total;
+}
+
+// Known leaf node counts, used to verify the move generator.
+struct PerftCase {
+  const char* fen;
+  int depth;
+  uint64_t nodes;
+};
+
+constexpr PerftCase kPerftSuite[] = {
+  {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+  {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+  {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+  {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+  {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487},
+};
+
+// Runs the perft suite, returning true if all node counts match.
+bool PerftSuite(const PerftOptions& options) {
+  bool all_passed = true;
+  for (const PerftCase& test : kPerftSuite) {
+    const Board board = Board::FromFEN(test.fen);
+    uint64_t nodes = 0;
+    for (const DivideEntry& entry : ParallelPerft(board, test.depth, options)) {
+      nodes += entry.nodes;
     }
-    else if (move->castling & Castling::QUEENSIDE) {
-      std::cout << "o-o-o";
+    const bool passed = nodes == test.nodes;
+    all_passed = all_passed && passed;
+    std::cout << (passed ? "OK   " : "FAIL ") << test.fen << " depth " << test.depth
+              << ": " << nodes << " (expected " << test.nodes << ")" << std::endl;
+  }
+  return all_passed;
+}
+
+// Won endgames, which the search must convert to mate in self-play.
+constexpr const char* kEndgameSuite[] = {
+  "8/8/8/3k4/8/8/8/4K2Q w - - 0 1",
+  "8/8/8/3k4/8/8/8/4K2R w - - 0 1",
+  "4k2q/8/8/8/3K4/8/8/8 b - - 0 1",
+  "4k2r/8/8/8/3K4/8/8/8 b - - 0 1",
+};
+
+// Plays out the endgame suite, without adjudication, and returns true if
+// the strong side mates in every game.
+bool EndgameSuite(int depth) {
+  TimeControl control;
+  control.depth = depth;
+  Adjudication adjudication;
+  adjudication.resign_score = 0;
+  adjudication.draw_moves = 0;
+  adjudication.bitbases = false;
+  adjudication.max_plies = 100;
+  SearchPlayer player(16, 1);
+  bool all_passed = true;
+  for (const char* fen : kEndgameSuite) {
+    const Board board = Board::FromFEN(fen);
+    const GameRecord game = PlayGame(board, player, player, control, adjudication);
+    const GameResult win = board.WhiteToMove() ? GameResult::WHITE_WINS : GameResult::BLACK_WINS;
+    const bool passed = game.result == win && game.termination == "checkmate";
+    all_passed = all_passed && passed;
+    std::cout << (passed ? "OK   " : "FAIL ") << fen << ": " << GameResultString(game.result)
+              << " by " << game.termination << " after " << game.moves.size() << " plies"
+              << std::endl;
+  }
+  return all_passed;
+}
+
+// Converts a file of newline separated FENs to packed positions.
+void PackFENFile(const std::string& input_path, const std::string& output_path) {
+  const auto start = std::chrono::steady_clock::now();
+  const MappedFile input(input_path);
+  PackedWriter writer(output_path);
+  size_t malformed = 0;
+  Board board;
+  ForEachLine(input.View(), [&](std::string_view line) {
+    if (Board::ParseFEN(line, board) == FenError::OK && board.CanPack()) {
+      writer.Write(board);
     }
     else {
-      std::cout << static_cast<char>(move->from.file + 'a') << move->from.rank + 1;
-      std::cout << static_cast<char>(move->to.file + 'a') << move->to.rank + 1;
-      if (move->promotion != Piece::EMPTY) {
-        if (move->promotion & Piece::QUEEN)
-          std::cout << "=q";
-        else if (move->promotion & Piece::KNIGHT)
-          std::cout << "=n";
-      }
+      malformed++;
     }
-    std::cout << " (" << eval << ") ";
+  });
+  writer.Close();
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cerr << "Packed " << writer.Count() << " positions, skipped " << malformed
+            << " malformed lines in " << elapsed.count() << " s" << std::endl;
+}
+
+// Converts a file of packed positions to newline separated FENs.
+void UnpackToFEN(const std::string& input_path, std::ostream& output) {
+  const auto start = std::chrono::steady_clock::now();
+  PackedReader reader(input_path);
+  Board board;
+  char fen[kMaxFENLength];
+  size_t count = 0;
+  while (reader.Next(board)) {
+    const size_t length = board.ToFEN(fen);
+    fen[length] = '\n';
+    output.write(fen, length + 1);
+    count++;
   }
-  std::cout << std::endl;
+  output.flush();
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cerr << "Unpacked " << count << " positions, skipped " << reader.Malformed()
+            << " malformed records in " << elapsed.count() << " s" << std::endl;
+}
+
+// Replays all games of a PGN database and reports the throughput.
+void ReplayPgnFile(std::istream& input, const PgnOptions& options) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto seconds = [&]() {
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return std::max(elapsed.count(), 1e-9);
+  };
+  const PgnStats stats = ReplayPgn(input, options, nullptr, [&](const PgnStats& progress) {
+    std::cerr << progress.games << " games, "
+              << static_cast<uint64_t>(progress.games / seconds()) << " games/s" << std::endl;
+  });
+
+  for (const PgnError& error : stats.first_errors) {
+    std::cerr << "Game " << error.game << ": " << error.message << std::endl;
+  }
+  const double elapsed = seconds();
+  std::cout << "Games: " << stats.games << std::endl;
+  std::cout << "Moves: " << stats.moves << std::endl;
+  std::cout << "Errors: " << stats.errors << std::endl;
+  std::cout << "Time: " << elapsed << " s" << std::endl;
+  std::cout << "Games/second: " << static_cast<uint64_t>(stats.games / elapsed) << std::endl;
+  std::cout << "MB/second: " << stats.bytes / elapsed / 1e6 << std::endl;
+}
+
+// Prints the statistics of the moves played in a position.
+void PrintExplorerMoves(const OpeningExplorer& explorer, const Board& board) {
+  const auto start = std::chrono::steady_clock::now();
+  const std::vector<ExplorerMove> moves = explorer.Lookup(board);
+  const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  for (const ExplorerMove& move : moves) {
+    const double games = static_cast<double>(move.Games());
+    std::cout << MoveToString(move.move) << ": " << move.Games() << " games, "
+              << 100 * move.white_wins / games << "% white, "
+              << 100 * move.draws / games << "% draws, "
+              << 100 * move.black_wins / games << "% black" << std::endl;
+  }
+  std::cout << moves.size() << " moves in " << elapsed.count() << " us" << std::endl;
 }
 
 }  // namespace
 
 int main(int argc, char** argv){
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+    // Usage: engine bench [depth] [--threads N] [--hash MB] [--stats FILE]
+    // Runs before bitbases are loaded, so that the node count does not
+    // depend on the files present. With --stats, writes the search
+    // statistics of each position to FILE as JSON lines, or to stdout if
+    // FILE is "-".
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    BenchOptions options;
+    options.depth = arguments.positional.empty() ? 3 : std::stoi(arguments.positional[0]);
+    options.threads = arguments.GetInt("threads", 1);
+    options.hash_megabytes = arguments.GetInt("hash", 16);
+    const std::string stats_path = arguments.Get("stats", "");
+    std::ofstream stats_file;
+    if (!stats_path.empty() && stats_path != "-") {
+      stats_file.open(stats_path);
+      if (!stats_file) {
+        std::cerr << "Cannot write " << stats_path << std::endl;
+        return 1;
+      }
+    }
+    if (!stats_path.empty()) {
+      options.stats_output = stats_path == "-" ? &std::cout : &stats_file;
+    }
+    const BenchResult result = RunBench(options, [](const std::string& fen, uint64_t nodes) {
+      std::cerr << fen << ": " << nodes << std::endl;
+    });
+    std::cout << "Positions: " << result.positions << std::endl;
+    std::cout << "Depth: " << options.depth << std::endl;
+    std::cout << "Threads: " << options.threads
+              << (options.threads > 1 ? " (node count varies between runs)" : "") << std::endl;
+    std::cout << "Nodes searched: " << result.nodes << std::endl;
+    std::cout << "Time: " << result.seconds << " s" << std::endl;
+    std::cout << "Nodes/second: " << result.NodesPerSecond() << std::endl;
+    return 0;
+  }
+
+  // Endgame bitbases are optional; see `make bitbases`.
+  const char* bitbase_directory = getenv("CHESSENGINE_BITBASES");
+  LoadBitbases(bitbase_directory != nullptr ? bitbase_directory : "bitbases");
+
+  if (argc > 1 && strcmp(argv[1], "smp") == 0) {
+    // Usage: engine smp [depth] [max threads]
+    const int depth = argc > 2 ? std::stoi(argv[2]) : 6;
+    const int max_threads = argc > 3 ? std::stoi(argv[3]) : 16;
+    SmpBenchmark(depth, max_threads);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "endgamesuite") == 0) {
+    // Usage: engine endgamesuite [--depth N]
+    // Verifies that won endgames are converted, with the bitbases loaded.
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    return EndgameSuite(arguments.GetInt("depth", 8)) ? 0 : 1;
+  }
+  if (argc > 1 && (strcmp(argv[1], "perft") == 0 || strcmp(argv[1], "perftsuite") == 0)) {
+    // Usage: engine perft <depth> [FEN] [--threads N] [--split N] [--hash MB]
+    //        engine perftsuite [--threads N] [--split N] [--hash MB]
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    PerftOptions options;
+    options.threads = arguments.GetInt("threads", DefaultThreads());
+    options.split_depth = arguments.GetInt("split", 2);
+    options.hash_megabytes = arguments.GetInt("hash", 0);
+    if (strcmp(argv[1], "perftsuite") == 0) {
+      return PerftSuite(options) ? 0 : 1;
+    }
+    if (arguments.positional.empty()) {
+      std::cerr << "Usage: engine perft <depth> [FEN] [--threads N] [--split N] [--hash MB]"
+                << std::endl;
+      return 1;
+    }
+    std::string fen = arguments.Join(1);
+    if (fen.empty()) {
+      fen = kStartPosition;
+    }
+    PerftDivide(Board::FromFEN(fen), std::stoi(arguments.positional[0]), options);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "trace") == 0) {
+    // Usage: engine trace <file> [FEN] [--depth N] [--hash MB]
+    // Records the search tree of the position, see tools/trace_summary.cc.
+    // Requires a build with `make TRACE=1`.
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    if (arguments.positional.empty()) {
+      std::cerr << "Usage: engine trace <file> [FEN] [--depth N] [--hash MB]" << std::endl;
+      return 1;
+    }
+    std::string fen = arguments.Join(1);
+    if (fen.empty()) {
+      fen = kStartPosition;
+    }
+    SearchLimits limits;
+    limits.depth = arguments.GetInt("depth", 4);
+    try {
+      TraceWriter trace(arguments.positional[0]);
+      Search search(arguments.GetInt("hash", 16));
+      search.SetTrace(&trace);
+      const SearchResult result = search.Run(Board::FromFEN(fen), limits);
+      trace.Close();
+      std::cout << "Score: " << result.score << ", " << result.nodes << " nodes" << std::endl;
+    }
+    catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+    // Usage: engine batch [file] [--threads N] [--depth N] [--nodes N]
+    //                     [--hash MB] [--format jsonl|csv]
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    BatchOptions options;
+    options.threads = arguments.GetInt("threads", DefaultThreads());
+    options.nodes = arguments.GetNumber<uint64_t>("nodes", 0);
+    // With only a node limit, search as deep as the limit allows.
+    options.depth = arguments.GetInt("depth", options.nodes > 0 ? kMaxDepth : 6);
+    options.hash_megabytes = arguments.GetInt("hash", 4);
+    options.format = (
+      arguments.Get("format", "jsonl") == "csv" ? BatchFormat::CSV : BatchFormat::JSONL);
+
+    const std::string path = arguments.positional.empty() ? "-" : arguments.positional[0];
+    if (path == "-") {
+      AnalyseBatch(std::cin, std::cout, options);
+      return 0;
+    }
+    std::ifstream input(path);
+    if (!input) {
+      std::cerr << "Could not open " << path << std::endl;
+      return 1;
+    }
+    AnalyseBatch(input, std::cout, options);
+    return 0;
+  }
+
+  if (argc > 1 && (strcmp(argv[1], "serve") == 0 || strcmp(argv[1], "worker") == 0)) {
+    // Usage: engine serve|worker [address] [--threads N] [--hash MB]
+    //                            [--hash-file PATH] [--queue N] [--cache N]
+    //                            [--depth N]
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    ServerOptions options;
+    if (!arguments.positional.empty()) {
+      options.address = arguments.positional[0];
+    }
+    options.threads = arguments.GetInt("threads", DefaultThreads());
+    options.hash_megabytes = arguments.GetInt("hash", 64);
+    options.hash_file = arguments.Get("hash-file", "");
+    options.max_queue = arguments.GetInt("queue", 64);
+    options.cache_size = arguments.GetInt("cache", 4096);
+    options.depth = arguments.GetInt("depth", 6);
+    try {
+      RunServer(options);
+    }
+    catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "coordinate") == 0) {
+    // Usage: engine coordinate batch [file] --workers A,B,... [options]
+    //        engine coordinate search [FEN] --workers A,B,... [options]
+    // Options: [--connections N] [--timeout ms] [--retries N] [--depth N]
+    //          [--nodes N] [--hash MB]
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    CoordinatorOptions options;
+    std::istringstream workers(arguments.Get("workers", ""));
+    std::string worker;
+    while (std::getline(workers, worker, ',')) {
+      options.workers.push_back(worker);
+    }
+    options.connections = arguments.GetInt("connections", 1);
+    options.task_timeout = arguments.GetInt("timeout", 60000);
+    options.max_retries = arguments.GetInt("retries", 3);
+    options.nodes = arguments.GetNumber<uint64_t>("nodes", 0);
+    options.depth = arguments.GetInt("depth", options.nodes > 0 ? kMaxDepth : 6);
+    options.hash_megabytes = arguments.GetInt("hash", 16);
+    options.log = &std::cerr;
+    const std::string mode = arguments.positional.empty() ? "" : arguments.positional[0];
+    if (options.workers.empty() || (mode != "batch" && mode != "search")) {
+      std::cerr << "Usage: engine coordinate batch|search ... --workers A,B,..." << std::endl;
+      return 1;
+    }
+
+    try {
+      if (mode == "batch") {
+        const std::string path = arguments.positional.size() < 2 ? "-" : arguments.positional[1];
+        if (path == "-") {
+          CoordinateBatch(std::cin, std::cout, options);
+          return 0;
+        }
+        std::ifstream input(path);
+        if (!input) {
+          std::cerr << "Could not open " << path << std::endl;
+          return 1;
+        }
+        CoordinateBatch(input, std::cout, options);
+        return 0;
+      }
+
+      std::string fen = arguments.Join(1);
+      if (fen.empty()) {
+        fen = kStartPosition;
+      }
+      const auto start = std::chrono::steady_clock::now();
+      const SearchResult result = CoordinateSearch(Board::FromFEN(fen), options.depth, options);
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      std::cout << "Best move: "
+                << (result.best_move.has_value() ? MoveToString(*result.best_move) : "none")
+                << std::endl;
+      std::cout << "Score: " << result.score << std::endl;
+      std::cout << "PV:";
+      for (const Move& move : result.pv) {
+        std::cout << " " << MoveToString(move);
+      }
+      std::cout << std::endl;
+      std::cout << "Nodes: " << result.nodes << std::endl;
+      std::cout << "Time: " << elapsed.count() << " s" << std::endl;
+    }
+    catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (argc > 1 && (strcmp(argv[1], "pack") == 0 || strcmp(argv[1], "unpack") == 0)) {
+    // Usage: engine pack <FEN file> <packed file>
+    //        engine unpack <packed file> [FEN file]
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    const bool pack = strcmp(argv[1], "pack") == 0;
+    if (arguments.positional.size() < (pack ? 2 : 1)) {
+      std::cerr << "Usage: engine pack <FEN file> <packed file>" << std::endl
+                << "       engine unpack <packed file> [FEN file]" << std::endl;
+      return 1;
+    }
+    try {
+      if (pack) {
+        PackFENFile(arguments.positional[0], arguments.positional[1]);
+      }
+      else if (arguments.positional.size() < 2 || arguments.positional[1] == "-") {
+        UnpackToFEN(arguments.positional[0], std::cout);
+      }
+      else {
+        std::ofstream output(arguments.positional[1]);
+        UnpackToFEN(arguments.positional[0], output);
+      }
+    }
+    catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "pgn") == 0) {
+    // Usage: engine pgn [file] [--threads N] [--chunk MB]
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    PgnOptions options;
+    options.threads = arguments.GetInt("threads", DefaultThreads());
+    options.chunk_bytes = static_cast<size_t>(arguments.GetInt("chunk", 4)) << 20;
+    const std::string path = arguments.positional.empty() ? "-" : arguments.positional[0];
+    if (path == "-") {
+      ReplayPgnFile(std::cin, options);
+      return 0;
+    }
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+      std::cerr << "Could not open " << path << std::endl;
+      return 1;
+    }
+    ReplayPgnFile(input, options);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "explore") == 0) {
+    // Usage: engine explore build <PGN file> <index> [--threads N] [--plies N]
+    //                                                 [--run MB]
+    //        engine explore <index> [FEN]
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    const bool build = !arguments.positional.empty() && arguments.positional[0] == "build";
+    if (arguments.positional.size() < (build ? 3 : 1)) {
+      std::cerr << "Usage: engine explore build <PGN file> <index> [options]" << std::endl
+                << "       engine explore <index> [FEN]" << std::endl;
+      return 1;
+    }
+    try {
+      if (!build) {
+        const std::string fen = arguments.Join(1);
+        const OpeningExplorer explorer(arguments.positional[0]);
+        PrintExplorerMoves(explorer, Board::FromFEN(fen.empty() ? kStartPosition : fen));
+        return 0;
+      }
+
+      ExplorerBuildOptions options;
+      options.pgn.threads = arguments.GetInt("threads", DefaultThreads());
+      options.max_plies = arguments.GetInt("plies", 40);
+      options.run_records =
+        (static_cast<size_t>(arguments.GetInt("run", 384)) << 20) / sizeof(ExplorerRecord);
+      std::ifstream input(arguments.positional[1], std::ios::binary);
+      if (!input) {
+        std::cerr << "Could not open " << arguments.positional[1] << std::endl;
+        return 1;
+      }
+      const auto start = std::chrono::steady_clock::now();
+      const ExplorerBuildStats stats = BuildExplorer(
+        input, arguments.positional[2], options, [](const PgnStats& progress) {
+          std::cerr << progress.games << " games" << std::endl;
+        });
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      std::cout << "Games: " << stats.games.games << std::endl;
+      std::cout << "Errors: " << stats.games.errors << std::endl;
+      std::cout << "Records: " << stats.records << std::endl;
+      std::cout << "Runs merged: " << stats.runs << std::endl;
+      std::cout << "Time: " << elapsed.count() << " s" << std::endl;
+    }
+    catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "book") == 0) {
+    // Usage: engine book <book file> [FEN]
+    const Arguments arguments = ParseArguments(argc, argv, 2);
+    if (arguments.positional.empty()) {
+      std::cerr << "Usage: engine book <book file> [FEN]" << std::endl;
+      return 1;
+    }
+    try {
+      const std::string fen = arguments.Join(1);
+      const Board board = Board::FromFEN(fen.empty() ? kStartPosition : fen);
+      const PolyglotBook book(arguments.positional[0]);
+      for (const BookMove& move : book.Lookup(board)) {
+        std::cout << MoveToString(move.move) << ": " << move.weight << std::endl;
+      }
+    }
+    catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "uci") == 0) {
+    RunUci(std::cin, std::cout);
+    return 0;
+  }
+
   std::string starting_pos;
   std::cout << "Starting position (leave empty for default):" << std::endl;
   // getline(std::cin, starting_pos);
   if (starting_pos.empty()) {
-    starting_pos = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    starting_pos = kStartPosition;
   }
 
   Board b = Board::FromFEN(starting_pos);
 
-  // while (true) {
   b.Print(std::cout);
   PrintAvailableMoves(b);
 
-    // const auto [from, to, castling, promotion] = GetMove(b);
-    // b.Move(from, to, promotion, castling);
-  // }
-
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,59 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+MappedFile::MappedFile(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throw std::runtime_error("cannot stat " + path + ": " + strerror(errno));
+  }
+  this->size = status.st_size;
+  if (this->size > 0) {
+    void* mapping = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("cannot map " + path + ": " + strerror(errno));
+    }
+    this->data = static_cast<const char*>(mapping);
+  }
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  this->Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+  : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+  if (this != &other) {
+    this->Unmap();
+    this->data = std::exchange(other.data, nullptr);
+    this->size = std::exchange(other.size, 0);
+  }
+  return *this;
+}
+
+void MappedFile::Unmap() {
+  if (this->data != nullptr) {
+    munmap(const_cast<char*>(this->data), this->size);
+    this->data = nullptr;
+    this->size = 0;
+  }
+}
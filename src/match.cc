@@ -0,0 +1,406 @@
+#include "match.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "bitbase.h"
+#include "board.h"
+#include "moves.h"
+#include "pieces.h"
+#include "search.h"
+#include "socket.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Time an engine is given to start, answer "isready" or quit.
+constexpr std::chrono::seconds kUciTimeout(10);
+// Time an engine may exceed its clock by before it is no longer waited for.
+// It loses on time either way.
+constexpr std::chrono::seconds kUciClockMargin(1);
+
+// Returns true if the kings are alone on the board, or with a single
+// knight or bishop between both sides.
+bool InsufficientMaterial(const Board& board) {
+  int minor_pieces = 0;
+  for (int square = 0; square < 64; square++) {
+    const Piece piece = board.Squares()[square];
+    if (piece == Piece::EMPTY || (piece & Piece::KING)) {
+      continue;
+    }
+    if (!(piece & (Piece::KNIGHT | Piece::BISHOP))) {
+      return false;
+    }
+    minor_pieces++;
+  }
+  return minor_pieces <= 1;
+}
+
+// Parses the score of an "info" line of a UCI engine, from the point of
+// view of the side to move, into a score from white's point of view.
+std::optional<int> ParseUciScore(const std::string& line, bool white_to_move) {
+  std::istringstream tokens(line);
+  std::string token;
+  while (tokens >> token) {
+    if (token != "score") {
+      continue;
+    }
+    std::string unit;
+    int value;
+    if (!(tokens >> unit >> value)) {
+      return std::nullopt;
+    }
+    if (unit == "mate") {
+      const bool white_wins = (value > 0) == white_to_move;
+      return white_wins ? std::numeric_limits<int>::max() : std::numeric_limits<int>::min();
+    }
+    if (unit == "cp") {
+      return white_to_move ? value : -value;
+    }
+  }
+  return std::nullopt;
+}
+
+}  // namespace
+
+SearchPlayer::SearchPlayer(size_t hash_megabytes, int threads)
+  : search(hash_megabytes), threads(threads) {}
+
+void SearchPlayer::NewGame() {
+  this->search.Clear();
+}
+
+PlayerMove SearchPlayer::Play(const Board& /*start*/,
+                              const std::vector<Move>& /*moves*/,
+                              const Board& position,
+                              const TimeControl& control,
+                              const std::array<int64_t, 2>& time_left) {
+  SearchLimits limits;
+  limits.threads = this->threads;
+  limits.depth = control.depth > 0 ? control.depth : kMaxDepth;
+  limits.nodes = control.nodes;
+  if (control.base > 0) {
+    limits.movetime = AllocateTime(
+      time_left[position.WhiteToMove() ? 0 : 1], control.increment, 0);
+  }
+  const SearchResult result = this->search.Run(position, limits);
+  return {result.best_move, result.score};
+}
+
+UciPlayer::UciPlayer(const std::vector<std::string>& command,
+                     const std::vector<std::pair<std::string, std::string>>& options)
+  : reader(-1) {
+  if (command.empty()) {
+    throw std::invalid_argument("empty engine command");
+  }
+  for (const std::string& word : command) {
+    this->command += (this->command.empty() ? "" : " ") + word;
+  }
+  // Prepared before forking, as the child may only make system calls.
+  std::vector<char*> argv;
+  for (const std::string& word : command) {
+    argv.push_back(const_cast<char*>(word.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+    throw std::runtime_error("cannot create socket pair: " + std::string(strerror(errno)));
+  }
+  this->pid = fork();
+  if (this->pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    throw std::runtime_error("cannot start " + this->command + ": " + strerror(errno));
+  }
+  if (this->pid == 0) {
+    dup2(fds[1], STDIN_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  close(fds[1]);
+  this->fd = fds[0];
+  this->reader = LineReader(this->fd);
+
+  // The destructor does not run if the constructor throws.
+  const auto fail = [this](const std::string& message) {
+    kill(this->pid, SIGKILL);
+    waitpid(this->pid, nullptr, 0);
+    close(this->fd);
+    throw std::runtime_error(message);
+  };
+  this->Send("uci");
+  if (!this->WaitFor("uciok", Clock::now() + kUciTimeout)) {
+    fail(this->command + " does not speak UCI");
+  }
+  for (const auto& [name, value] : options) {
+    this->Send("setoption name " + name + " value " + value);
+  }
+  this->Send("isready");
+  if (!this->WaitFor("readyok", Clock::now() + kUciTimeout)) {
+    fail(this->command + " is not ready");
+  }
+}
+
+UciPlayer::~UciPlayer() {
+  this->Send("quit");
+  const Clock::time_point deadline = Clock::now() + kUciTimeout;
+  while (waitpid(this->pid, nullptr, WNOHANG) == 0) {
+    if (Clock::now() >= deadline) {
+      kill(this->pid, SIGKILL);
+      waitpid(this->pid, nullptr, 0);
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  close(this->fd);
+}
+
+void UciPlayer::Send(const std::string& line) {
+  SendAll(this->fd, line + "\n");
+}
+
+bool UciPlayer::WaitFor(const std::string& prefix, Clock::time_point deadline) {
+  std::string line;
+  while (true) {
+    const int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - Clock::now()).count();
+    if (remaining <= 0 || !this->reader.ReadLine(line, remaining)) {
+      return false;
+    }
+    if (line.compare(0, prefix.size(), prefix) == 0) {
+      return true;
+    }
+  }
+}
+
+void UciPlayer::NewGame() {
+  this->Send("ucinewgame");
+  this->Send("isready");
+  this->WaitFor("readyok", Clock::now() + kUciTimeout);
+}
+
+PlayerMove UciPlayer::Play(const Board& start,
+                           const std::vector<Move>& moves,
+                           const Board& position,
+                           const TimeControl& control,
+                           const std::array<int64_t, 2>& time_left) {
+  std::string command = "position fen " + start.ToFEN();
+  if (!moves.empty()) {
+    command += " moves";
+    for (const Move& move : moves) {
+      command += " " + MoveToString(move);
+    }
+  }
+  this->Send(command);
+
+  std::ostringstream go;
+  go << "go";
+  if (control.base > 0) {
+    go << " wtime " << time_left[0] << " btime " << time_left[1]
+       << " winc " << control.increment << " binc " << control.increment;
+  }
+  if (control.depth > 0) {
+    go << " depth " << control.depth;
+  }
+  if (control.nodes > 0) {
+    go << " nodes " << control.nodes;
+  }
+  this->Send(go.str());
+
+  // Without a clock, the engine is waited for as long as it runs.
+  const int64_t timeout = (
+    control.base > 0 ? time_left[position.WhiteToMove() ? 0 : 1] +
+    std::chrono::milliseconds(kUciClockMargin).count() : -1);
+  const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+  PlayerMove reply;
+  std::string line;
+  while (true) {
+    int64_t remaining = -1;
+    if (timeout >= 0) {
+      remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - Clock::now()).count();
+      if (remaining <= 0) {
+        break;
+      }
+    }
+    if (!this->reader.ReadLine(line, remaining)) {
+      break;
+    }
+    if (line.compare(0, 5, "info ") == 0) {
+      if (const std::optional<int> score = ParseUciScore(line, position.WhiteToMove())) {
+        reply.score = score;
+      }
+    }
+    else if (line.compare(0, 9, "bestmove ") == 0) {
+      std::istringstream tokens(line.substr(9));
+      std::string move;
+      tokens >> move;
+      reply.move = MoveFromString(position, move);
+      return reply;
+    }
+  }
+  // Too late; the move is not waited for, and the game is lost anyway.
+  this->Send("stop");
+  this->WaitFor("bestmove", Clock::now() + kUciTimeout);
+  reply.move = std::nullopt;
+  return reply;
+}
+
+const char* GameResultString(GameResult result) {
+  switch (result) {
+    case GameResult::WHITE_WINS: return "1-0";
+    case GameResult::DRAW: return "1/2-1/2";
+    case GameResult::BLACK_WINS: return "0-1";
+  }
+  return "*";
+}
+
+GameRecord PlayGame(const Board& start, Player& white, Player& black,
+                    const TimeControl& control, const Adjudication& adjudication) {
+  GameRecord record;
+  record.start = start;
+  Board position = start;
+  std::vector<uint64_t> hashes = {position.Hash()};
+  std::array<int64_t, 2> time_left = {control.base, control.base};
+  Player* players[2] = {&white, &black};
+  white.NewGame();
+  black.NewGame();
+
+  const auto end = [&record](GameResult result, const char* termination) {
+    record.result = result;
+    record.termination = termination;
+    return record;
+  };
+  const auto win = [](bool white_wins) {
+    return white_wins ? GameResult::WHITE_WINS : GameResult::BLACK_WINS;
+  };
+  // Consecutive plies with scores deciding the game for white and black,
+  // or drawing it.
+  int winning_plies[2] = {0, 0};
+  int drawn_plies = 0;
+
+  while (true) {
+    const bool white_to_move = position.WhiteToMove();
+    const int side = white_to_move ? 0 : 1;
+
+    MoveIterator iterator(position);
+    if (!iterator.Next(true, true, true).has_value()) {
+      const SquareIndex king = position.KingsPosition(white_to_move);
+      if (IsAttacked(position, king, !white_to_move)) {
+        return end(win(!white_to_move), "checkmate");
+      }
+      return end(GameResult::DRAW, "stalemate");
+    }
+    if (position.HalfmoveClock() >= 100) {
+      return end(GameResult::DRAW, "fifty moves");
+    }
+    if (std::count(hashes.begin(), hashes.end(), hashes.back()) >= 3) {
+      return end(GameResult::DRAW, "repetition");
+    }
+    if (InsufficientMaterial(position)) {
+      return end(GameResult::DRAW, "insufficient material");
+    }
+    if (adjudication.bitbases) {
+      if (const std::optional<int> score = ProbeBitbases(position)) {
+        return end(*score == 0 ? GameResult::DRAW : win(*score > 0), "bitbase");
+      }
+    }
+    if (static_cast<int>(record.moves.size()) >= adjudication.max_plies) {
+      return end(GameResult::DRAW, "move limit");
+    }
+
+    const Clock::time_point move_start = Clock::now();
+    const PlayerMove reply = players[side]->Play(
+      start, record.moves, position, control, time_left);
+    if (control.base > 0) {
+      time_left[side] -= std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - move_start).count();
+      if (time_left[side] < 0) {
+        return end(win(!white_to_move), "time forfeit");
+      }
+      time_left[side] += control.increment;
+    }
+    if (!reply.move.has_value() || !IsLegal(position, *reply.move)) {
+      return end(win(!white_to_move), "illegal move");
+    }
+    const Move move = *reply.move;
+    position.Move(move.from, move.to, move.promotion, move.castling);
+    record.moves.push_back(move);
+    record.scores.push_back(reply.score);
+    hashes.push_back(position.Hash());
+
+    if (!reply.score.has_value()) {
+      winning_plies[0] = winning_plies[1] = drawn_plies = 0;
+      continue;
+    }
+    const int score = *reply.score;
+    winning_plies[0] = score >= adjudication.resign_score ? winning_plies[0] + 1 : 0;
+    winning_plies[1] = score <= -adjudication.resign_score ? winning_plies[1] + 1 : 0;
+    const bool drawish = (
+      static_cast<int>(record.moves.size()) >= adjudication.draw_ply &&
+      score >= -adjudication.draw_score && score <= adjudication.draw_score);
+    drawn_plies = drawish ? drawn_plies + 1 : 0;
+    if (adjudication.resign_score > 0) {
+      for (const int winner : {0, 1}) {
+        if (winning_plies[winner] >= 2 * adjudication.resign_moves) {
+          return end(win(winner == 0), "adjudication");
+        }
+      }
+    }
+    if (adjudication.draw_moves > 0 && drawn_plies >= 2 * adjudication.draw_moves) {
+      return end(GameResult::DRAW, "adjudication");
+    }
+  }
+}
+
+double EloFromScore(double score) {
+  return -400 * std::log10(1 / score - 1);
+}
+
+double Sprt::LogLikelihoodRatio(uint64_t wins, uint64_t draws, uint64_t losses) const {
+  const double games = wins + draws + losses;
+  if (wins == 0 || losses == 0) {
+    // The variance can not be estimated yet.
+    return 0;
+  }
+  const double win = wins / games;
+  const double draw = draws / games;
+  const double loss = losses / games;
+  const double score = win + draw / 2;
+  const double variance = (
+    win * (1 - score) * (1 - score) +
+    draw * (0.5 - score) * (0.5 - score) +
+    loss * score * score);
+  const auto expected_score = [](double elo) {
+    return 1 / (1 + std::pow(10, -elo / 400));
+  };
+  const double score0 = expected_score(this->elo0);
+  const double score1 = expected_score(this->elo1);
+  return games * (score1 - score0) * (2 * score - score0 - score1) / (2 * variance);
+}
+
+double Sprt::LowerBound() const {
+  return std::log(this->beta / (1 - this->alpha));
+}
+
+double Sprt::UpperBound() const {
+  return std::log((1 - this->beta) / this->alpha);
+}
@@ -1,12 +1,29 @@
 #include "moves.h"
 
+#include <cstring>
 #include <optional>
+#include <string>
+#include <string_view>
 
 #include "board.h"
 #include "pieces.h"
+#include "scan.h"
 
 namespace {
 
+// Returns the piece type of an upper case SAN piece letter, or EMPTY.
+Piece PieceFromLetter(char letter) {
+	switch (letter) {
+		case 'P': return Piece::PAWN;
+		case 'N': return Piece::KNIGHT;
+		case 'B': return Piece::BISHOP;
+		case 'R': return Piece::ROOK;
+		case 'Q': return Piece::QUEEN;
+		case 'K': return Piece::KING;
+	}
+	return Piece::EMPTY;
+}
+
 inline bool IsEmpty(const Board& board, int8_t file, int8_t rank) {
 	return board.Get(file, rank) == Piece::EMPTY;
 }
@@ -26,6 +43,10 @@ void PawnMove(const Board& board,
 	const int8_t target_rank = from.rank + direction;
 	const bool is_promotional_square = target_rank == (is_white ? 7 : 0);
 	const bool is_starting_rank = from.rank == (is_white ? 1 : 6);
+	if (target_rank < 0 || target_rank > 7) {
+		// Only reachable from `IsAttacked`, for squares on the last rank.
+		return;
+	}
 
 	if (non_capturing && IsEmpty(board, from.file, target_rank)) {
 		SquareIndex to = {.file = from.file, .rank = target_rank};
@@ -134,8 +155,11 @@ void BishopMove(const Board& board,
 					break;
 				if (to.file < 0 || to.file > 7)
 					break;
-				if (non_capturing && IsEmpty(board, to.file, to.rank)) {
-					output.push_back({.from = from, .to = to});
+				if (IsEmpty(board, to.file, to.rank)) {
+					// Keep sliding past empty squares even when only generating
+					// captures.
+					if (non_capturing)
+						output.push_back({.from = from, .to = to});
 				} else if (CanCapture(board, is_white, to.file, to.rank)) {
 					if (capturing)
 						output.push_back({.from = from, .to = to});
@@ -168,8 +192,11 @@ void RookMove(const Board& board,
 					break;
 				if (to.file < 0 || to.file > 7)
 					break;
-				if (non_capturing && IsEmpty(board, to.file, to.rank)) {
-					output.push_back({.from = from, .to = to});
+				if (IsEmpty(board, to.file, to.rank)) {
+					// Keep sliding past empty squares even when only generating
+					// captures.
+					if (non_capturing)
+						output.push_back({.from = from, .to = to});
 				} else if (CanCapture(board, is_white, to.file, to.rank)) {
 					if (capturing)
 						output.push_back({.from = from, .to = to});
@@ -302,14 +329,19 @@ void PossibleMoves(const Board& board,
 }
 
 std::optional<SquareIndex> FindKing(const Board& board, bool white) {
-	std::optional<SquareIndex> square = SquareIndex({.file = -1, .rank = 0});
-	while (square.has_value()) {
-		if (board.Get(square->file, square->rank) & Piece::KING) {
-			return square;
-		}
-		square = board.NextOccupied(*square, white);
+	const uint8_t color = white ? static_cast<uint8_t>(Piece::IS_WHITE) : 0;
+	const uint64_t kings = MatchOccupied(
+		board.Squares(),
+		static_cast<uint8_t>(Piece::KING | Piece::IS_WHITE),
+		static_cast<uint8_t>(Piece::KING) | color);
+	if (kings == 0) {
+		return std::nullopt;
 	}
-	return std::nullopt;
+	const int index = __builtin_ctzll(kings);
+	return SquareIndex{
+		.file = static_cast<int8_t>(index % 8),
+		.rank = static_cast<int8_t>(index / 8),
+	};
 }
 
 }  // namespace
@@ -364,6 +396,223 @@ bool IsAttacked(const Board& board, SquareIndex square, bool by_white) {
 	return false;
 }
 
+std::string MoveToString(const Move& move) {
+	std::string output;
+	output.push_back('a' + move.from.file);
+	output.push_back('1' + move.from.rank);
+	output.push_back('a' + move.to.file);
+	output.push_back('1' + move.to.rank);
+	if (move.promotion & Piece::QUEEN)
+		output.push_back('q');
+	else if (move.promotion & Piece::ROOK)
+		output.push_back('r');
+	else if (move.promotion & Piece::BISHOP)
+		output.push_back('b');
+	else if (move.promotion & Piece::KNIGHT)
+		output.push_back('n');
+	return output;
+}
+
+std::optional<Move> MoveFromString(const Board& board, const std::string& text) {
+	MoveIterator iterator(board);
+	while (const std::optional<Move> move = iterator.Next(true, true, true)) {
+		if (MoveToString(*move) == text) {
+			return move;
+		}
+	}
+	return std::nullopt;
+}
+
+std::optional<Move> MoveFromSAN(const Board& board, std::string_view san) {
+	// Check marks and annotations carry no information about the move.
+	while (!san.empty() && strchr("+#!?", san.back()) != nullptr) {
+		san.remove_suffix(1);
+	}
+
+	Castling castling = Castling::NO_CASTLING;
+	if (san == "O-O" || san == "0-0") {
+		castling = Castling::KINGSIDE;
+	}
+	else if (san == "O-O-O" || san == "0-0-0") {
+		castling = Castling::QUEENSIDE;
+	}
+
+	Piece piece = Piece::PAWN;
+	Piece promotion = Piece::EMPTY;
+	SquareIndex to = {-1, -1};
+	int8_t from_file = -1;
+	int8_t from_rank = -1;
+	if (castling == Castling::NO_CASTLING) {
+		if (!san.empty() && san[0] >= 'A' && san[0] <= 'Z') {
+			piece = PieceFromLetter(san[0]);
+			if (piece == Piece::EMPTY) {
+				return std::nullopt;
+			}
+			san.remove_prefix(1);
+		}
+		// Promotions are written as "e8=Q", or sometimes "e8Q".
+		if (!san.empty() && san.back() >= 'A' && san.back() <= 'Z') {
+			promotion = PieceFromLetter(san.back());
+			san.remove_suffix(1);
+			if (!san.empty() && san.back() == '=') {
+				san.remove_suffix(1);
+			}
+		}
+		if (san.size() < 2) {
+			return std::nullopt;
+		}
+		to.file = san[san.size() - 2] - 'a';
+		to.rank = san[san.size() - 1] - '1';
+		if (to.file < 0 || to.file > 7 || to.rank < 0 || to.rank > 7) {
+			return std::nullopt;
+		}
+		san.remove_suffix(2);
+		// What is left disambiguates the moving piece.
+		for (const char c : san) {
+			if ('a' <= c && c <= 'h') {
+				from_file = c - 'a';
+			}
+			else if ('1' <= c && c <= '8') {
+				from_rank = c - '1';
+			}
+			else if (c != 'x') {
+				return std::nullopt;
+			}
+		}
+	}
+
+	std::optional<Move> found;
+	MoveIterator iterator(board);
+	while (const std::optional<Move> move = iterator.Next(true, true, true)) {
+		if (move->castling != castling) {
+			continue;
+		}
+		if (castling != Castling::NO_CASTLING) {
+			return move;
+		}
+		if (
+			!(board.Get(move->from.file, move->from.rank) & piece) ||
+			move->to.file != to.file || move->to.rank != to.rank ||
+			(from_file >= 0 && move->from.file != from_file) ||
+			(from_rank >= 0 && move->from.rank != from_rank) ||
+			(move->promotion == Piece::EMPTY) != (promotion == Piece::EMPTY) ||
+			(promotion != Piece::EMPTY && !(move->promotion & promotion))
+		) {
+			continue;
+		}
+		if (found.has_value()) {
+			return std::nullopt;
+		}
+		found = move;
+	}
+	return found;
+}
+
+uint32_t PackMove(const Move& move) {
+	uint32_t promotion = 0;
+	if (move.promotion != Piece::EMPTY) {
+		// Piece type as a 3 bit index, and the color as the 4th bit.
+		promotion = __builtin_ctz(static_cast<uint8_t>(move.promotion) & 63);
+		promotion |= move.promotion & Piece::IS_WHITE ? 8 : 0;
+	}
+	return (
+		static_cast<uint32_t>(move.from.rank * 8 + move.from.file) |
+		static_cast<uint32_t>(move.to.rank * 8 + move.to.file) << 6 |
+		promotion << 12 |
+		static_cast<uint32_t>(move.castling) << 16
+	);
+}
+
+Move UnpackMove(uint32_t packed) {
+	Move move;
+	move.from = {
+		.file = static_cast<int8_t>(packed & 7),
+		.rank = static_cast<int8_t>((packed >> 3) & 7),
+	};
+	move.to = {
+		.file = static_cast<int8_t>((packed >> 6) & 7),
+		.rank = static_cast<int8_t>((packed >> 9) & 7),
+	};
+	const uint32_t promotion = (packed >> 12) & 15;
+	if (promotion != 0) {
+		move.promotion = static_cast<Piece>(1 << (promotion & 7));
+		if (promotion & 8) {
+			move.promotion = move.promotion | Piece::IS_WHITE;
+		}
+	}
+	move.castling = static_cast<Castling>((packed >> 16) & 3);
+	return move;
+}
+
+bool IsLegal(const Board& board, const Move& move) {
+	const Piece piece = board.Get(move.from.file, move.from.rank);
+	if (
+		piece == Piece::EMPTY ||
+		static_cast<bool>(piece & Piece::IS_WHITE) != board.WhiteToMove()
+	) {
+		return false;
+	}
+	std::vector<Move> moves;
+	PossibleMoves(board, move.from, moves, true, true);
+	for (const Move& candidate : moves) {
+		if (candidate != move) {
+			continue;
+		}
+		Board position = board;
+		position.Move(move.from, move.to, move.promotion, move.castling);
+		return !IsAttacked(
+			position, position.KingsPosition(board.WhiteToMove()), !board.WhiteToMove());
+	}
+	return false;
+}
+
+int CountLegalMoves(const Board& board) {
+	const bool whites_move = board.WhiteToMove();
+	const SquareIndex king = board.KingsPosition(whites_move);
+	const bool in_check = IsAttacked(board, king, !whites_move);
+	const std::optional<SquareIndex> en_passent = board.EnPassantSquare();
+
+	std::vector<Move> moves;
+	moves.reserve(64);
+	uint64_t occupied = board.Occupancy(whites_move);
+	while (occupied != 0) {
+		const int index = __builtin_ctzll(occupied);
+		occupied &= occupied - 1;
+		const SquareIndex from = {
+			.file = static_cast<int8_t>(index % 8),
+			.rank = static_cast<int8_t>(index / 8),
+		};
+		PossibleMoves(board, from, moves, true, true);
+	}
+
+	int count = 0;
+	for (const Move& move : moves) {
+		const int8_t file_offset = move.from.file - king.file;
+		const int8_t rank_offset = move.from.rank - king.rank;
+		// A piece that does not share a line with its king cannot be pinned.
+		const bool may_be_pinned = (
+			file_offset == 0 || rank_offset == 0 ||
+			file_offset == rank_offset || file_offset == -rank_offset
+		);
+		const bool is_en_passent = (
+			en_passent.has_value() &&
+			board.Get(move.from.file, move.from.rank) & Piece::PAWN &&
+			move.to.file == en_passent->file && move.to.rank == en_passent->rank
+		);
+		if (!in_check && !may_be_pinned && !is_en_passent) {
+			count++;
+			continue;
+		}
+		// Otherwise the move must be played to see if it exposes the king.
+		Board position = board;
+		position.Move(move.from, move.to, move.promotion, move.castling);
+		if (!IsAttacked(position, position.KingsPosition(whites_move), !whites_move)) {
+			count++;
+		}
+	}
+	return count;
+}
+
 MoveIterator::MoveIterator(const Board& board)
 	: source_position(board) {
 	Reset();
@@ -0,0 +1,92 @@
+#include "packed_file.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "mapped_file.h"
+
+namespace {
+
+// Positions buffered before writing, 128 KiB.
+constexpr size_t kWriteBuffer = 4096;
+
+}  // namespace
+
+PackedWriter::PackedWriter(const std::string& path)
+  : path(path), file(fopen(path.c_str(), "wb")) {
+  if (this->file == nullptr) {
+    throw std::runtime_error("cannot create " + path + ": " + strerror(errno));
+  }
+  if (fwrite(kPackedFileMagic, sizeof(kPackedFileMagic), 1, this->file) != 1) {
+    fclose(this->file);
+    throw std::runtime_error("cannot write " + path + ": " + strerror(errno));
+  }
+  this->buffer.reserve(kWriteBuffer);
+}
+
+PackedWriter::~PackedWriter() {
+  if (this->file != nullptr) {
+    // Errors can not be reported from a destructor; call Close() to see them.
+    this->Flush();
+    fclose(this->file);
+  }
+}
+
+void PackedWriter::Write(const Board& board) {
+  this->buffer.push_back(board.Pack());
+  this->count++;
+  if (this->buffer.size() == kWriteBuffer) {
+    this->Flush();
+  }
+}
+
+void PackedWriter::Close() {
+  if (this->file == nullptr) {
+    return;
+  }
+  this->Flush();
+  const bool failed = ferror(this->file) != 0;
+  const bool close_failed = fclose(this->file) != 0;
+  this->file = nullptr;
+  if (failed || close_failed) {
+    throw std::runtime_error("cannot write " + this->path);
+  }
+}
+
+void PackedWriter::Flush() {
+  if (!this->buffer.empty()) {
+    // Failures are sticky and reported by Close().
+    fwrite(this->buffer.data(), sizeof(PackedBoard), this->buffer.size(), this->file);
+    this->buffer.clear();
+  }
+}
+
+PackedReader::PackedReader(const std::string& path) : file(path) {
+  if (this->file.Size() < sizeof(kPackedFileMagic) ||
+      memcmp(this->file.Data(), kPackedFileMagic, sizeof(kPackedFileMagic)) != 0) {
+    throw std::runtime_error(path + " is not a file of packed positions");
+  }
+  // PackedBoard is plain bytes, so records need no alignment.
+  this->records = reinterpret_cast<const PackedBoard*>(
+    this->file.Data() + sizeof(kPackedFileMagic));
+  this->count = (this->file.Size() - sizeof(kPackedFileMagic)) / sizeof(PackedBoard);
+}
+
+bool PackedReader::Get(size_t index, Board& board) const {
+  return index < this->count && Board::Unpack(this->records[index], board);
+}
+
+bool PackedReader::Next(Board& board) {
+  while (this->position < this->count) {
+    if (Board::Unpack(this->records[this->position++], board)) {
+      return true;
+    }
+    this->malformed++;
+  }
+  return false;
+}
@@ -0,0 +1,154 @@
+#include "perft.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "board.h"
+#include "moves.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Caches node counts by position and depth. Like the search's hash table,
+// the key is stored xor'ed with the data so that concurrent writes need no
+// locks: a torn entry simply fails to match.
+class PerftTable {
+ public:
+  explicit PerftTable(size_t megabytes) {
+    this->size = 1;
+    while (this->size * 2 * sizeof(Slot) <= megabytes << 20) {
+      this->size *= 2;
+    }
+    this->slots = std::make_unique<Slot[]>(this->size);
+    for (size_t i = 0; i < this->size; i++) {
+      this->slots[i].check.store(0, std::memory_order_relaxed);
+      this->slots[i].data.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  std::optional<uint64_t> Probe(uint64_t key, int depth) const {
+    const Slot& slot = this->slots[key & (this->size - 1)];
+    const uint64_t data = slot.data.load(std::memory_order_relaxed);
+    const uint64_t check = slot.check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || static_cast<int>(data & 0xFF) != depth) {
+      return std::nullopt;
+    }
+    return data >> 8;
+  }
+
+  void Store(uint64_t key, int depth, uint64_t nodes) {
+    Slot& slot = this->slots[key & (this->size - 1)];
+    const uint64_t data = nodes << 8 | static_cast<uint8_t>(depth);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+
+  std::unique_ptr<Slot[]> slots;
+  size_t size;
+};
+
+uint64_t HashedPerft(PerftTable* table, const Board& board, int depth) {
+  if (table == nullptr || depth <= 1) {
+    return Perft(board, depth);
+  }
+  const uint64_t key = board.Hash();
+  if (const std::optional<uint64_t> nodes = table->Probe(key, depth)) {
+    return *nodes;
+  }
+  uint64_t nodes = 0;
+  MoveIterator iterator(board);
+  while (iterator.Next(true, true, true).has_value()) {
+    nodes += HashedPerft(table, *iterator.CurrentPosition(), depth - 1);
+  }
+  table->Store(key, depth, nodes);
+  return nodes;
+}
+
+// Node counters indexed by worker and root move. Each worker only writes
+// to its own row, so no synchronisation is needed until merging.
+using Counters = std::vector<std::vector<uint64_t>>;
+
+void PerftTask(ThreadPool& pool,
+               Counters& counters,
+               PerftTable* table,
+               const Board& board,
+               const int depth,
+               const int split_depth,
+               const size_t root_index) {
+  if (depth <= 1 || split_depth <= 0) {
+    counters[ThreadPool::CurrentWorker()][root_index] += HashedPerft(table, board, depth);
+    return;
+  }
+  // Split the subtree further, one task per move.
+  MoveIterator iterator(board);
+  while (iterator.Next(true, true, true).has_value()) {
+    pool.Submit(
+      [&pool, &counters, table, position = *iterator.CurrentPosition(),
+       depth, split_depth, root_index]() {
+        PerftTask(pool, counters, table, position, depth - 1, split_depth - 1, root_index);
+      });
+  }
+}
+
+}  // namespace
+
+uint64_t Perft(const Board& board, int depth) {
+  if (depth <= 0) {
+    return 1;
+  }
+  if (depth == 1) {
+    return CountLegalMoves(board);
+  }
+  uint64_t nodes = 0;
+  MoveIterator iterator(board);
+  while (iterator.Next(true, true, true).has_value()) {
+    nodes += Perft(*iterator.CurrentPosition(), depth - 1);
+  }
+  return nodes;
+}
+
+std::vector<DivideEntry> ParallelPerft(
+  const Board& board, int depth, const PerftOptions& options) {
+  if (depth <= 0) {
+    return {};
+  }
+  std::vector<DivideEntry> divide;
+  std::vector<Board> positions;
+  MoveIterator iterator(board);
+  while (const std::optional<Move> move = iterator.Next(true, true, true)) {
+    divide.push_back({.move = *move});
+    positions.push_back(*iterator.CurrentPosition());
+  }
+
+  std::unique_ptr<PerftTable> table;
+  if (options.hash_megabytes > 0) {
+    table = std::make_unique<PerftTable>(options.hash_megabytes);
+  }
+
+  ThreadPool pool(options.threads);
+  Counters counters(pool.Size(), std::vector<uint64_t>(divide.size(), 0));
+  for (size_t i = 0; i < positions.size(); i++) {
+    pool.Submit([&pool, &counters, &positions, &table, &options, depth, i]() {
+      PerftTask(
+        pool, counters, table.get(), positions[i], depth - 1, options.split_depth - 1, i);
+    });
+  }
+  pool.Wait();
+
+  for (const std::vector<uint64_t>& worker_counters : counters) {
+    for (size_t i = 0; i < divide.size(); i++) {
+      divide[i].nodes += worker_counters[i];
+    }
+  }
+  return divide;
+}
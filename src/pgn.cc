@@ -0,0 +1,344 @@
+#include "pgn.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "moves.h"
+#include "thread_pool.h"
+
+namespace {
+
+constexpr char kStartPosition[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Outcome of parsing one chunk, with game numbers relative to the chunk.
+struct ChunkResult {
+  uint64_t games = 0;
+  uint64_t moves = 0;
+  uint64_t errors = 0;
+  std::vector<PgnError> first_errors;
+};
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsResult(std::string_view token) {
+  return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+// Returns the offset of the last tag section start in `text` that follows
+// an empty line, or 0 if there is none after the first line.
+size_t LastGameStart(std::string_view text) {
+  for (size_t pos = text.rfind("\n["); pos != std::string_view::npos && pos > 0;
+       pos = text.rfind("\n[", pos - 1)) {
+    const size_t line_end = text.rfind('\n', pos - 1);
+    const size_t line_start = line_end == std::string_view::npos ? 0 : line_end + 1;
+    const std::string_view previous_line = text.substr(line_start, pos - line_start);
+    if (previous_line.find_first_not_of(" \t\r") == std::string_view::npos) {
+      return pos + 1;
+    }
+  }
+  return 0;
+}
+
+// Parses and replays the games of a chunk that starts at a game.
+class ChunkParser {
+ public:
+  ChunkParser(std::string_view text, const PgnVisitor& visit, size_t max_errors)
+    : text(text), visit(visit), max_errors(max_errors) {}
+
+  ChunkResult Parse() {
+    while (this->pos < this->text.size()) {
+      const char c = this->text[this->pos];
+      if (IsSpace(c)) {
+        this->pos++;
+      }
+      else if (c == '[') {
+        if (this->in_movetext) {
+          // The previous game has no result.
+          this->Finish();
+        }
+        this->ParseTag();
+      }
+      else if (c == '{') {
+        this->SkipPast('}');
+      }
+      else if (c == ';' || (c == '%' && (this->pos == 0 || this->text[this->pos - 1] == '\n'))) {
+        this->SkipPast('\n');
+      }
+      else if (c == '(') {
+        this->SkipVariation();
+      }
+      else if (c == ')') {
+        this->pos++;
+      }
+      else if (c == '$') {
+        // Numeric annotation glyph.
+        this->pos++;
+        while (this->pos < this->text.size() && isdigit(static_cast<unsigned char>(this->text[this->pos]))) {
+          this->pos++;
+        }
+      }
+      else {
+        this->ParseToken();
+      }
+    }
+    if (this->in_game) {
+      this->Finish();
+    }
+    return this->result;
+  }
+
+ private:
+  void SkipPast(char end) {
+    const size_t found = this->text.find(end, this->pos);
+    this->pos = found == std::string_view::npos ? this->text.size() : found + 1;
+  }
+
+  // Skips a variation, with nested variations and comments.
+  void SkipVariation() {
+    int depth = 0;
+    while (this->pos < this->text.size()) {
+      const char c = this->text[this->pos++];
+      if (c == '{') {
+        this->SkipPast('}');
+      }
+      else if (c == '(') {
+        depth++;
+      }
+      else if (c == ')' && --depth == 0) {
+        return;
+      }
+    }
+  }
+
+  void ParseTag() {
+    this->in_game = true;
+    const size_t end = this->text.find_first_of("]\n", this->pos);
+    const std::string_view tag = this->text.substr(
+      this->pos + 1, (end == std::string_view::npos ? this->text.size() : end) - this->pos - 1);
+    this->pos = end == std::string_view::npos ? this->text.size() : end + 1;
+
+    const size_t name_end = tag.find(' ');
+    const size_t value_start = tag.find('"');
+    const size_t value_end = tag.rfind('"');
+    if (name_end == std::string_view::npos || value_start == value_end) {
+      return;
+    }
+    std::string value;
+    for (size_t i = value_start + 1; i < value_end; i++) {
+      if (tag[i] == '\\' && i + 1 < value_end) {
+        i++;
+      }
+      value.push_back(tag[i]);
+    }
+    this->game.tags.emplace_back(std::string(tag.substr(0, name_end)), std::move(value));
+  }
+
+  void StartMovetext() {
+    this->in_game = true;
+    this->in_movetext = true;
+    std::string_view fen = kStartPosition;
+    for (const auto& [name, value] : this->game.tags) {
+      if (name == "FEN") {
+        fen = value;
+      }
+    }
+    if (Board::ParseFEN(fen, this->game.start) != FenError::OK) {
+      this->Fail("invalid FEN tag");
+    }
+    this->board = this->game.start;
+  }
+
+  void ParseToken() {
+    const size_t start = this->pos;
+    while (this->pos < this->text.size() && !IsSpace(this->text[this->pos]) &&
+           strchr("{}()[];$", this->text[this->pos]) == nullptr) {
+      this->pos++;
+    }
+    std::string_view token = this->text.substr(start, this->pos - start);
+    if (token.empty()) {
+      // A stray character that starts no token.
+      this->pos++;
+      return;
+    }
+    if (!this->in_movetext) {
+      this->StartMovetext();
+    }
+    if (IsResult(token)) {
+      this->game.result = std::string(token);
+      this->Finish();
+      return;
+    }
+
+    // Move numbers, "12." or "12...", possibly attached to the move. Digits
+    // without a dot are castling written with zeros.
+    size_t digits = 0;
+    while (digits < token.size() && isdigit(static_cast<unsigned char>(token[digits]))) {
+      digits++;
+    }
+    if (digits > 0 && digits < token.size() && token[digits] == '.') {
+      token.remove_prefix(digits);
+      while (!token.empty() && token[0] == '.') {
+        token.remove_prefix(1);
+      }
+    }
+    if (token.empty() || this->failed) {
+      return;
+    }
+
+    const std::optional<Move> move = MoveFromSAN(this->board, token);
+    if (!move.has_value()) {
+      this->Fail("illegal move " + std::string(token) + " at ply " +
+                 std::to_string(this->game.moves.size() + 1));
+      return;
+    }
+    this->board.Move(move->from, move->to, move->promotion, move->castling);
+    this->game.moves.push_back(*move);
+  }
+
+  void Fail(const std::string& message) {
+    if (!this->failed) {
+      this->failed = true;
+      this->error = message;
+    }
+  }
+
+  void Finish() {
+    if (!this->in_movetext) {
+      this->StartMovetext();
+    }
+    const uint64_t index = this->games_seen++;
+    if (this->failed) {
+      this->result.errors++;
+      if (this->result.first_errors.size() < this->max_errors) {
+        this->result.first_errors.push_back({index, this->error});
+      }
+    }
+    else {
+      this->game.end = this->board;
+      this->result.games++;
+      this->result.moves += this->game.moves.size();
+      if (this->visit) {
+        this->visit(this->game);
+      }
+    }
+    this->game.tags.clear();
+    this->game.moves.clear();
+    this->game.result.clear();
+    this->in_game = false;
+    this->in_movetext = false;
+    this->failed = false;
+  }
+
+  const std::string_view text;
+  const PgnVisitor& visit;
+  const size_t max_errors;
+  size_t pos = 0;
+
+  PgnGame game;
+  Board board;
+  bool in_game = false;
+  bool in_movetext = false;
+  bool failed = false;
+  std::string error;
+  uint64_t games_seen = 0;
+  ChunkResult result;
+};
+
+}  // namespace
+
+PgnStats ReplayPgn(std::istream& input,
+                   const PgnOptions& options,
+                   const PgnVisitor& visit,
+                   const PgnProgress& progress) {
+  ThreadPool pool(options.threads);
+  const size_t max_in_flight = 2 * pool.Size();
+
+  std::mutex mutex;
+  std::condition_variable chunk_done;
+  // Results by chunk, in input order. A deque, so that workers can store
+  // results while chunks are added.
+  std::deque<std::optional<ChunkResult>> chunks;
+  size_t in_flight = 0;
+  PgnStats running;
+
+  std::vector<char> block(std::max<size_t>(options.chunk_bytes, 1));
+  std::string pending;
+  auto last_report = std::chrono::steady_clock::now();
+  bool done = false;
+  while (!done) {
+    input.read(block.data(), block.size());
+    const size_t count = input.gcount();
+    done = count < block.size();
+    pending.append(block.data(), count);
+
+    // Chunks end before the start of a game, so that they can be parsed on
+    // their own.
+    const size_t split = done ? pending.size() : LastGameStart(pending);
+    if (split == 0) {
+      // A game longer than a chunk.
+      continue;
+    }
+    auto chunk = std::make_shared<const std::string>(pending, 0, split);
+    pending.erase(0, split);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    chunk_done.wait(lock, [&]() { return in_flight < max_in_flight; });
+    in_flight++;
+    running.bytes += chunk->size();
+    const size_t index = chunks.size();
+    chunks.emplace_back();
+    lock.unlock();
+
+    pool.Submit([&, chunk, index]() {
+      ChunkResult result = ChunkParser(*chunk, visit, options.max_errors).Parse();
+      std::lock_guard<std::mutex> lock(mutex);
+      running.games += result.games;
+      running.moves += result.moves;
+      running.errors += result.errors;
+      chunks[index] = std::move(result);
+      in_flight--;
+      chunk_done.notify_one();
+    });
+
+    const auto now = std::chrono::steady_clock::now();
+    if (progress && now - last_report >= std::chrono::seconds(1)) {
+      last_report = now;
+      lock.lock();
+      const PgnStats snapshot = running;
+      lock.unlock();
+      progress(snapshot);
+    }
+  }
+  pool.Wait();
+
+  // Number the games across chunks, which are in input order.
+  PgnStats stats;
+  stats.bytes = running.bytes;
+  uint64_t first_game = 1;
+  for (const std::optional<ChunkResult>& chunk : chunks) {
+    stats.games += chunk->games;
+    stats.moves += chunk->moves;
+    stats.errors += chunk->errors;
+    for (const PgnError& error : chunk->first_errors) {
+      if (stats.first_errors.size() < options.max_errors) {
+        stats.first_errors.push_back({first_game + error.game, error.message});
+      }
+    }
+    first_game += chunk->games + chunk->errors;
+  }
+  return stats;
+}
@@ -0,0 +1,140 @@
+#include "scan.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHESSENGINE_SCAN_X86
+#endif
+
+#include "pieces.h"
+
+namespace {
+
+uint64_t MatchOccupiedScalar(const Piece* squares, uint8_t mask, uint8_t value) {
+  uint64_t result = 0;
+  for (int i = 0; i < 64; i++) {
+    const uint8_t piece = static_cast<uint8_t>(squares[i]);
+    if (piece != 0 && (piece & mask) == value) {
+      result |= uint64_t{1} << i;
+    }
+  }
+  return result;
+}
+
+int WeightedCountScalar(const Piece* squares, const PieceWeight* weights, int count) {
+  int value = 0;
+  for (int i = 0; i < 64; i++) {
+    if (squares[i] == Piece::EMPTY) {
+      continue;
+    }
+    for (int j = 0; j < count; j++) {
+      if (squares[i] == weights[j].piece) {
+        value += weights[j].weight;
+        break;
+      }
+    }
+  }
+  return value;
+}
+
+#ifdef CHESSENGINE_SCAN_X86
+
+// Two 32-byte halves of the board, compared lane by lane.
+__attribute__((target("avx2,popcnt")))
+uint64_t MatchOccupiedAvx2(const Piece* squares, uint8_t mask, uint8_t value) {
+  const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(squares));
+  const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(squares + 32));
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i masks = _mm256_set1_epi8(static_cast<char>(mask));
+  const __m256i values = _mm256_set1_epi8(static_cast<char>(value));
+
+  const __m256i low_match = _mm256_andnot_si256(
+    _mm256_cmpeq_epi8(low, zero),
+    _mm256_cmpeq_epi8(_mm256_and_si256(low, masks), values));
+  const __m256i high_match = _mm256_andnot_si256(
+    _mm256_cmpeq_epi8(high, zero),
+    _mm256_cmpeq_epi8(_mm256_and_si256(high, masks), values));
+
+  const uint32_t low_bits = static_cast<uint32_t>(_mm256_movemask_epi8(low_match));
+  const uint32_t high_bits = static_cast<uint32_t>(_mm256_movemask_epi8(high_match));
+  return (static_cast<uint64_t>(high_bits) << 32) | low_bits;
+}
+
+__attribute__((target("avx2,popcnt")))
+int WeightedCountAvx2(const Piece* squares, const PieceWeight* weights, int count) {
+  const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(squares));
+  const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(squares + 32));
+
+  int value = 0;
+  for (int j = 0; j < count; j++) {
+    const __m256i piece = _mm256_set1_epi8(static_cast<char>(weights[j].piece));
+    const uint32_t low_bits = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, piece)));
+    const uint32_t high_bits = static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, piece)));
+    value += weights[j].weight * (__builtin_popcount(low_bits) + __builtin_popcount(high_bits));
+  }
+  return value;
+}
+
+// The whole board fits in a single 64-byte register.
+__attribute__((target("avx512f,avx512bw,popcnt")))
+uint64_t MatchOccupiedAvx512(const Piece* squares, uint8_t mask, uint8_t value) {
+  const __m512i board = _mm512_loadu_si512(squares);
+  const __mmask64 occupied = _mm512_test_epi8_mask(board, board);
+  return _mm512_mask_cmpeq_epi8_mask(
+    occupied,
+    _mm512_and_si512(board, _mm512_set1_epi8(static_cast<char>(mask))),
+    _mm512_set1_epi8(static_cast<char>(value)));
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+int WeightedCountAvx512(const Piece* squares, const PieceWeight* weights, int count) {
+  const __m512i board = _mm512_loadu_si512(squares);
+
+  int value = 0;
+  for (int j = 0; j < count; j++) {
+    const __mmask64 matches = _mm512_cmpeq_epi8_mask(
+      board, _mm512_set1_epi8(static_cast<char>(weights[j].piece)));
+    value += weights[j].weight * __builtin_popcountll(matches);
+  }
+  return value;
+}
+
+#endif  // CHESSENGINE_SCAN_X86
+
+struct ScanKernels {
+  const char* name;
+  uint64_t (*match_occupied)(const Piece*, uint8_t, uint8_t);
+  int (*weighted_count)(const Piece*, const PieceWeight*, int);
+};
+
+ScanKernels SelectKernels() {
+#ifdef CHESSENGINE_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw")) {
+    return {"avx512", MatchOccupiedAvx512, WeightedCountAvx512};
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return {"avx2", MatchOccupiedAvx2, WeightedCountAvx2};
+  }
+#endif
+  return {"scalar", MatchOccupiedScalar, WeightedCountScalar};
+}
+
+const ScanKernels kKernels = SelectKernels();
+
+}  // namespace
+
+uint64_t MatchOccupied(const Piece* squares, uint8_t mask, uint8_t value) {
+  return kKernels.match_occupied(squares, mask, value);
+}
+
+int WeightedCount(const Piece* squares, const PieceWeight* weights, int count) {
+  return kKernels.weighted_count(squares, weights, count);
+}
+
+const char* ScanKernelName() {
+  return kKernels.name;
+}
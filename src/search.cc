@@ -0,0 +1,631 @@
+#include "search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bitbase.h"
+#include "board.h"
+#include "evaluation.h"
+#include "moves.h"
+#include "pieces.h"
+#include "search_stats.h"
+#include "trace.h"
+#include "transposition.h"
+
+namespace {
+
+// State owned by a single search thread.
+struct ThreadContext {
+  TranspositionTable* table;
+  std::atomic<bool>* stop;
+  // Set by the caller to cancel the search, may be null.
+  const std::atomic<bool>* stop_token = nullptr;
+  int thread_id = 0;
+  uint64_t nodes = 0;
+  // Stops the search when `nodes` reaches this value, unless 0.
+  uint64_t node_limit = 0;
+  // Stops the search at this time, if set.
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  // Stops the search at the time it holds, see SearchLimits::deadline.
+  const std::atomic<int64_t>* deadline_token = nullptr;
+  // Depth of the current iteration, to find the ply of a node.
+  int root_depth = 0;
+  // Root moves scored exactly, see SearchLimits::multi_pv.
+  int multi_pv = 1;
+  SearchStats stats;
+  // Receives the nodes of the main thread, may be null.
+  TraceWriter* trace = nullptr;
+  // Why the node that returned last returned its score.
+  TraceReason trace_reason = TraceReason::SEARCHED;
+};
+
+// Nodes between checks of the clock.
+constexpr uint64_t kClockInterval = 1024;
+
+// Time reserved for communication with the GUI, in milliseconds.
+constexpr int64_t kMoveOverhead = 50;
+
+struct RootMove {
+  Move move;
+  Board position;
+  // Score of the last iteration, exact for the first `multi_pv` moves.
+  int score = 0;
+};
+
+inline bool Stopped(const ThreadContext& context) {
+  return (
+    context.stop->load(std::memory_order_relaxed) ||
+    (context.stop_token != nullptr && context.stop_token->load(std::memory_order_relaxed)));
+}
+
+// Increments a statistics counter, unless statistics are compiled out.
+inline void Count(uint64_t& counter) {
+  if constexpr (kSearchStats) {
+    counter++;
+  }
+}
+
+inline void CountPly(ThreadContext& context, int ply) {
+  if constexpr (kSearchStats) {
+    context.stats.selective_depth = std::max(context.stats.selective_depth, ply);
+  }
+}
+
+// Returns `score`, noting why the node returns it for the trace.
+inline int Traced(ThreadContext& context, TraceReason reason, int score) {
+  if constexpr (kSearchTrace) {
+    context.trace_reason = reason;
+  }
+  return score;
+}
+
+// Records a node that returned `score`, after being searched from its
+// parent with `move`, or the root if null.
+inline void TraceNode(ThreadContext& context, int ply, int depth, const Move* move,
+                      int alpha, int beta, int score) {
+  if constexpr (kSearchTrace) {
+    if (context.trace != nullptr) {
+      context.trace->Write({
+        .alpha = alpha, .beta = beta, .score = score,
+        .move = move != nullptr ? PackMove(*move) : 0,
+        .ply = static_cast<uint16_t>(ply), .depth = static_cast<int8_t>(depth),
+        .reason = context.trace_reason});
+    }
+  }
+}
+
+inline void CountNode(ThreadContext& context) {
+  if (++context.nodes == context.node_limit) {
+    context.stop->store(true, std::memory_order_relaxed);
+  }
+  if (
+    (context.deadline.has_value() || context.deadline_token != nullptr) &&
+    context.nodes % kClockInterval == 0
+  ) {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const int64_t token = (
+      context.deadline_token != nullptr ? context.deadline_token->load(std::memory_order_relaxed)
+                                        : 0);
+    if ((context.deadline.has_value() && now >= *context.deadline) ||
+        (token != 0 && now.time_since_epoch() >= std::chrono::milliseconds(token))) {
+      context.stop->store(true, std::memory_order_relaxed);
+    }
+  }
+}
+
+int Qiecence(ThreadContext& context, MoveIterator& iterator, const int depth, int alpha, int beta) {
+  int num_moves = 0;
+  const Board* source_position = iterator.SourcePosition();
+  const bool white_to_move = source_position->WhiteToMove();
+  CountNode(context);
+  Count(context.stats.qnodes);
+  CountPly(context, context.root_depth + depth);
+
+  if (source_position->HalfmoveClock() >= 50) {
+    // Draw by 50-move rule.
+    return Traced(context, TraceReason::FIFTY_MOVES, 0);
+  }
+  if (Stopped(context)) {
+    return Traced(context, TraceReason::STOPPED, 0);
+  }
+
+  const SquareIndex king = source_position->KingsPosition(white_to_move);
+  const bool is_in_check = IsAttacked(*source_position, king, !white_to_move);
+  // Unless in check, the side to move may decline all captures and keep the
+  // current material balance.
+  const int stand_pat = CountPieces(source_position);
+  Count(context.stats.evaluations);
+
+  int min_max;
+  if (white_to_move) {
+    min_max = is_in_check ? std::numeric_limits<int>::min() : stand_pat;
+    if (min_max >= beta)
+      return Traced(context, TraceReason::STAND_PAT, min_max);
+    alpha = min_max > alpha ? min_max : alpha;
+    while (const std::optional<Move> move = iterator.Next(false, true, depth < 4)) {
+      MoveIterator next = iterator.ContinuePosition();
+      const int eval = Qiecence(context, next, depth + 1, alpha, beta);
+      TraceNode(context, context.root_depth + depth + 1, -(depth + 1), &*move, alpha, beta, eval);
+      min_max = eval > min_max ? eval : min_max;
+      if (min_max >= beta)
+        return Traced(context, TraceReason::CUTOFF, min_max);
+      alpha = min_max > alpha ? min_max : alpha;
+      num_moves++;
+    }
+  }
+  else {
+    min_max = is_in_check ? std::numeric_limits<int>::max() : stand_pat;
+    if (min_max <= alpha)
+      return Traced(context, TraceReason::STAND_PAT, min_max);
+    beta = min_max < beta ? min_max : beta;
+    while (const std::optional<Move> move = iterator.Next(false, true, depth < 4)) {
+      MoveIterator next = iterator.ContinuePosition();
+      const int eval = Qiecence(context, next, depth + 1, alpha, beta);
+      TraceNode(context, context.root_depth + depth + 1, -(depth + 1), &*move, alpha, beta, eval);
+      min_max = eval < min_max ? eval : min_max;
+      if (min_max <= alpha)
+        return Traced(context, TraceReason::CUTOFF, min_max);
+      beta = min_max < beta ? min_max : beta;
+      num_moves++;
+    }
+  }
+
+  if (num_moves == 0 && is_in_check) {
+    // King is in check, and we have no moves. This is checkmate
+    return Traced(context, TraceReason::CHECKMATE,
+                  white_to_move ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max());
+  }
+  return Traced(context, TraceReason::SEARCHED, min_max);
+}
+
+int AlphaBeta(ThreadContext& context, MoveIterator& iterator, const int depth, int alpha, int beta) {
+  const Board* source_position = iterator.SourcePosition();
+  const bool white_to_move = source_position->WhiteToMove();
+
+  if (source_position->HalfmoveClock() >= 50) {
+    // Draw by 50-move rule.
+    return Traced(context, TraceReason::FIFTY_MOVES, 0);
+  }
+  // Drawn endgames with few pieces are cut off. Won ones are searched on,
+  // so that the mate is found, and only scored by the bitbase at the
+  // leaves, unless the side to move is already mated.
+  if (const std::optional<int> score = ProbeBitbases(*source_position)) {
+    if (*score == 0 || (depth <= 0 && MoveIterator(*source_position).Next(true, true, true))) {
+      Count(context.stats.bitbase_hits);
+      return Traced(context, TraceReason::BITBASE, *score);
+    }
+  }
+  if (depth <= 0) {
+    return Qiecence(context, iterator, 0, alpha, beta);
+  }
+  if (Stopped(context)) {
+    return Traced(context, TraceReason::STOPPED, 0);
+  }
+  CountNode(context);
+  Count(context.stats.nodes);
+  CountPly(context, context.root_depth - depth);
+
+  // Reuse results from earlier iterations and other threads.
+  const uint64_t key = source_position->Hash();
+  std::optional<Move> hash_move;
+  Count(context.stats.table_probes);
+  if (const std::optional<TableEntry> entry = context.table->Probe(key)) {
+    Count(context.stats.table_hits);
+    // Mates may be further away than `depth`, and are searched again, so
+    // that the shortest one is found.
+    const bool is_mate = (entry->score == std::numeric_limits<int>::max() ||
+                          entry->score == std::numeric_limits<int>::min());
+    if (entry->depth >= depth && !is_mate && (
+          entry->bound == Bound::EXACT ||
+          (entry->bound == Bound::LOWER && entry->score >= beta) ||
+          (entry->bound == Bound::UPPER && entry->score <= alpha))) {
+      Count(context.stats.table_cutoffs);
+      return Traced(context, TraceReason::TABLE, entry->score);
+    }
+    // The key may collide with another position, so verify the move.
+    if (entry->move.has_value() && IsLegal(*source_position, *entry->move)) {
+      hash_move = entry->move;
+    }
+  }
+
+  const int original_alpha = alpha;
+  const int original_beta = beta;
+  int num_moves = 0;
+  int min_max = (
+    white_to_move ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max());
+  std::optional<Move> best_move;
+
+  const auto count_cutoff = [&]() {
+    Count(context.stats.cutoffs);
+    if (num_moves == 1) {
+      Count(context.stats.first_move_cutoffs);
+    }
+  };
+
+  // Searches the position after `move`, and returns true if the remaining
+  // moves can be skipped.
+  const auto visit = [&](const Move& move, const Board& position) {
+    MoveIterator next(position);
+    const int eval = AlphaBeta(context, next, depth - 1, alpha, beta);
+    TraceNode(context, context.root_depth - depth + 1, depth - 1, &move, alpha, beta, eval);
+    num_moves++;
+    if (white_to_move) {
+      if (eval > min_max || !best_move.has_value()) {
+        min_max = eval;
+        best_move = move;
+      }
+      if (min_max >= beta) {
+        count_cutoff();
+        return true;
+      }
+      alpha = min_max > alpha ? min_max : alpha;
+    }
+    else {
+      if (eval < min_max || !best_move.has_value()) {
+        min_max = eval;
+        best_move = move;
+      }
+      if (min_max <= alpha) {
+        count_cutoff();
+        return true;
+      }
+      beta = min_max < beta ? min_max : beta;
+    }
+    return false;
+  };
+
+  bool cutoff = false;
+  if (hash_move.has_value()) {
+    Board position = *source_position;
+    position.Move(hash_move->from, hash_move->to, hash_move->promotion, hash_move->castling);
+    cutoff = visit(*hash_move, position);
+  }
+  while (!cutoff) {
+    const std::optional<Move> move = iterator.Next(true, true, true);
+    if (!move.has_value()) {
+      break;
+    }
+    if (hash_move.has_value() && *move == *hash_move) {
+      continue;
+    }
+    cutoff = visit(*move, *iterator.CurrentPosition());
+  }
+
+  if (Stopped(context)) {
+    // The result is incomplete, and must not be stored.
+    return Traced(context, TraceReason::STOPPED, 0);
+  }
+
+  if (num_moves == 0) {
+    const SquareIndex king = source_position->KingsPosition(white_to_move);
+    const bool is_in_check = IsAttacked(*source_position, king, !white_to_move);
+
+    if (is_in_check) {
+      // King is in check, and we have no moves. This is checkmate
+      return Traced(context, TraceReason::CHECKMATE,
+                    white_to_move ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max());
+    }
+    else {
+      // Stalemate, it's a draw.
+      return Traced(context, TraceReason::STALEMATE, 0);
+    }
+  }
+
+  Bound bound = Bound::EXACT;
+  if (min_max <= original_alpha) {
+    bound = Bound::UPPER;
+  }
+  else if (min_max >= original_beta) {
+    bound = Bound::LOWER;
+  }
+  context.table->Store(key, {
+    .score = min_max, .depth = depth, .bound = bound, .move = best_move});
+  return Traced(context, cutoff ? TraceReason::CUTOFF : TraceReason::SEARCHED, min_max);
+}
+
+// Searches all root moves to `depth`, and moves the best `multi_pv` moves
+// to the front, best first, with their exact scores. Returns the score, or
+// nullopt if the search was stopped before completing.
+std::optional<int> SearchRoot(ThreadContext& context,
+                              const Board& board,
+                              std::vector<RootMove>& root_moves,
+                              const int depth) {
+  const bool white_to_move = board.WhiteToMove();
+  const size_t multi_pv = std::max(context.multi_pv, 1);
+  // Indices of the best moves so far, best first.
+  std::vector<size_t> best;
+  context.root_depth = depth;
+  // Ends the iteration in the trace with the root.
+  const auto trace_root = [&](TraceReason reason, int score) {
+    Traced(context, reason, score);
+    TraceNode(context, 0, depth, nullptr, std::numeric_limits<int>::min(),
+              std::numeric_limits<int>::max(), score);
+  };
+
+  const auto better = [white_to_move](int score, int than) {
+    return white_to_move ? score > than : score < than;
+  };
+  // Searches root move `i` within the window, returns false if stopped.
+  const auto search = [&](size_t i, int alpha, int beta) {
+    MoveIterator next(root_moves[i].position);
+    root_moves[i].score = AlphaBeta(context, next, depth - 1, alpha, beta);
+    TraceNode(context, 1, depth - 1, &root_moves[i].move, alpha, beta, root_moves[i].score);
+    return !Stopped(context);
+  };
+
+  for (size_t i = 0; i < root_moves.size(); i++) {
+    bool searched;
+    if (best.size() < multi_pv) {
+      searched = search(i, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    }
+    else {
+      // Only a move better than the last of the best moves needs an exact
+      // score, searched with the window beyond that move's score.
+      const int bound = root_moves[best.back()].score;
+      if (multi_pv == 1) {
+        searched = (white_to_move ? search(i, bound, std::numeric_limits<int>::max())
+                                  : search(i, std::numeric_limits<int>::min(), bound));
+      }
+      else if (bound == (white_to_move ? std::numeric_limits<int>::max()
+                                       : std::numeric_limits<int>::min())) {
+        // No move is better than a mate, nor has a null window beyond it.
+        continue;
+      }
+      else {
+        // Most moves are refuted by a null window, and only the others
+        // searched again.
+        searched = (white_to_move ? search(i, bound, bound + 1) : search(i, bound - 1, bound));
+        if (searched && better(root_moves[i].score, bound)) {
+          searched = (white_to_move ? search(i, bound, std::numeric_limits<int>::max())
+                                    : search(i, std::numeric_limits<int>::min(), bound));
+        }
+      }
+    }
+    if (!searched) {
+      trace_root(TraceReason::STOPPED, 0);
+      return std::nullopt;
+    }
+    if (best.size() == multi_pv && !better(root_moves[i].score, root_moves[best.back()].score)) {
+      continue;
+    }
+    // Moves searched earlier stay ahead of moves of the same score.
+    const auto position = std::find_if(best.begin(), best.end(), [&](size_t index) {
+      return better(root_moves[i].score, root_moves[index].score);
+    });
+    best.insert(position, i);
+    if (best.size() > multi_pv) {
+      best.pop_back();
+    }
+  }
+  CountNode(context);
+
+  if (root_moves.empty()) {
+    const SquareIndex king = board.KingsPosition(white_to_move);
+    if (IsAttacked(board, king, !white_to_move)) {
+      const int score = (
+        white_to_move ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max());
+      trace_root(TraceReason::CHECKMATE, score);
+      return score;
+    }
+    trace_root(TraceReason::STALEMATE, 0);
+    return 0;
+  }
+
+  // The best moves go first, and the others keep their order.
+  std::vector<RootMove> ordered;
+  ordered.reserve(root_moves.size());
+  for (const size_t index : best) {
+    ordered.push_back(root_moves[index]);
+  }
+  for (size_t i = 0; i < root_moves.size(); i++) {
+    if (std::find(best.begin(), best.end(), i) == best.end()) {
+      ordered.push_back(root_moves[i]);
+    }
+  }
+  root_moves = std::move(ordered);
+  const int min_max = root_moves.front().score;
+  context.table->Store(board.Hash(), {
+    .score = min_max, .depth = depth, .bound = Bound::EXACT, .move = root_moves.front().move});
+  trace_root(TraceReason::SEARCHED, min_max);
+  return min_max;
+}
+
+// Follows the hash moves from the position after `best_move`, to find the
+// expected line of play.
+std::vector<Move> PrincipalVariation(const TranspositionTable& table,
+                                     const Board& board,
+                                     const Move& best_move,
+                                     const int depth) {
+  std::vector<Move> pv = {best_move};
+  Board position = board;
+  position.Move(best_move.from, best_move.to, best_move.promotion, best_move.castling);
+  while (static_cast<int>(pv.size()) < depth) {
+    const std::optional<TableEntry> entry = table.Probe(position.Hash());
+    if (!entry.has_value() || !entry->move.has_value() || !IsLegal(position, *entry->move)) {
+      break;
+    }
+    const Move move = *entry->move;
+    position.Move(move.from, move.to, move.promotion, move.castling);
+    pv.push_back(move);
+  }
+  return pv;
+}
+
+// Runs the iterative deepening loop of one thread. Helper threads start
+// with a rotated root move order, and every other helper searches one ply
+// deeper, so that the threads spread out over the tree.
+void IterativeDeepening(ThreadContext& context,
+                        const Board& board,
+                        const int max_depth,
+                        SearchResult* result,
+                        const ProgressCallback* progress) {
+  std::vector<RootMove> root_moves;
+  MoveIterator iterator(board);
+  while (const std::optional<Move> move = iterator.Next(true, true, true)) {
+    root_moves.push_back({.move = *move, .position = *iterator.CurrentPosition()});
+  }
+  if (context.thread_id > 0 && !root_moves.empty()) {
+    std::rotate(
+      root_moves.begin(),
+      root_moves.begin() + context.thread_id % root_moves.size(),
+      root_moves.end());
+  }
+
+  if (result != nullptr && !root_moves.empty()) {
+    // Fallback in case the search is stopped before the first iteration.
+    result->best_move = root_moves.front().move;
+    result->pv = {*result->best_move};
+    result->lines = {{.move = *result->best_move, .score = 0, .pv = result->pv}};
+  }
+
+  const int first_depth = 1 + context.thread_id % 2;
+  for (int depth = first_depth; depth <= max_depth; depth++) {
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t nodes_before = context.nodes;
+    const std::optional<int> score = SearchRoot(context, board, root_moves, depth);
+    if (!score.has_value()) {
+      break;
+    }
+    if constexpr (kSearchStats) {
+      std::vector<SearchStats::Iteration>& iterations = context.stats.iterations;
+      SearchStats::Iteration iteration;
+      iteration.depth = depth;
+      iteration.nodes = context.nodes - nodes_before;
+      iteration.milliseconds = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+      if (!iterations.empty() && iterations.back().nodes > 0) {
+        iteration.branching_factor =
+          static_cast<double>(iteration.nodes) / iterations.back().nodes;
+      }
+      iterations.push_back(iteration);
+    }
+    if (result != nullptr) {
+      result->score = *score;
+      result->depth = depth;
+      result->nodes = context.nodes;
+      if (!root_moves.empty()) {
+        result->best_move = root_moves.front().move;
+        result->pv = PrincipalVariation(*context.table, board, *result->best_move, depth);
+        result->lines.clear();
+        const size_t lines = std::min<size_t>(std::max(context.multi_pv, 1), root_moves.size());
+        for (size_t i = 0; i < lines; i++) {
+          result->lines.push_back({
+            .move = root_moves[i].move, .score = root_moves[i].score,
+            .pv = i == 0 ? result->pv
+                         : PrincipalVariation(*context.table, board, root_moves[i].move, depth)});
+        }
+      }
+      if (progress != nullptr && *progress) {
+        (*progress)(*result);
+      }
+    }
+    // Mate scores carry no distance, so a deeper iteration could only trade
+    // the shortest mate for a longer one, and shuffle without ever mating.
+    if (*score == (board.WhiteToMove() ? std::numeric_limits<int>::max()
+                                       : std::numeric_limits<int>::min())) {
+      break;
+    }
+  }
+}
+
+}  // namespace
+
+int64_t AllocateTime(int64_t time_left, int64_t increment, int moves_to_go) {
+  const int64_t moves = moves_to_go > 0 ? moves_to_go : 30;
+  const int64_t budget = time_left / moves + increment * 3 / 4;
+  return std::clamp<int64_t>(budget, 1, std::max<int64_t>(time_left - kMoveOverhead, 1));
+}
+
+int64_t DeadlineAfter(int64_t milliseconds) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count() + milliseconds;
+}
+
+Search::Search(size_t table_megabytes)
+  : Search(std::make_shared<TranspositionTable>(table_megabytes)) {}
+
+Search::Search(std::shared_ptr<TranspositionTable> table)
+  : table(std::move(table)), stop(false) {}
+
+SearchResult Search::Run(const Board& board,
+                         const SearchLimits& limits,
+                         const ProgressCallback& progress,
+                         const std::atomic<bool>* stop_token) {
+  this->stop.store(false);
+  const int max_depth = std::clamp(limits.depth, 1, kMaxDepth);
+  const int num_threads = std::max(limits.threads, 1);
+
+  std::vector<ThreadContext> contexts(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    contexts[i].table = this->table.get();
+    contexts[i].stop = &this->stop;
+    contexts[i].stop_token = stop_token;
+    contexts[i].thread_id = i;
+    contexts[i].multi_pv = limits.multi_pv;
+  }
+  contexts[0].node_limit = limits.nodes;
+  contexts[0].trace = this->trace;
+  if (limits.movetime > 0) {
+    contexts[0].deadline = (
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.movetime));
+  }
+  contexts[0].deadline_token = limits.deadline;
+
+  std::vector<std::thread> helpers;
+  for (int i = 1; i < num_threads; i++) {
+    helpers.emplace_back([&, i]() {
+      IterativeDeepening(contexts[i], board, max_depth, nullptr, nullptr);
+    });
+  }
+
+  SearchResult result;
+  IterativeDeepening(contexts[0], board, max_depth, &result, &progress);
+
+  // The main thread decides when the search is done.
+  this->stop.store(true);
+  for (std::thread& helper : helpers) {
+    helper.join();
+  }
+  result.nodes = 0;
+  for (const ThreadContext& context : contexts) {
+    result.nodes += context.nodes;
+  }
+  if constexpr (kSearchStats) {
+    result.stats = std::move(contexts[0].stats);
+    for (int i = 1; i < num_threads; i++) {
+      result.stats.Merge(contexts[i].stats);
+    }
+    if (this->stats_output != nullptr) {
+      *this->stats_output << result.stats.ToJson() << std::endl;
+    }
+  }
+  return result;
+}
+
+void Search::SetStatsOutput(std::ostream* output) {
+  this->stats_output = output;
+}
+
+void Search::SetTrace(TraceWriter* trace) {
+  if (!kSearchTrace && trace != nullptr) {
+    throw std::runtime_error("tracing requires a build with `make TRACE=1`");
+  }
+  this->trace = trace;
+}
+
+void Search::Stop() {
+  this->stop.store(true);
+}
+
+void Search::Clear() {
+  this->table->Clear();
+}
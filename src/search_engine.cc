@@ -0,0 +1,64 @@
+#include "search_engine.h"
+
+#include <atomic>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "board.h"
+#include "search.h"
+#include "thread_pool.h"
+#include "transposition.h"
+
+SearchEngine::SearchEngine(const EngineOptions& options)
+  : table(std::make_shared<TranspositionTable>(options.hash_megabytes)),
+    pool(options.workers) {
+  for (int i = 0; i < this->pool.Size(); i++) {
+    this->searches.push_back(std::make_unique<::Search>(this->table));
+  }
+}
+
+SearchEngine::~SearchEngine() {
+  this->StopAll();
+  this->pool.Wait();
+}
+
+std::future<SearchResult> SearchEngine::Search(const Board& board,
+                                               const SearchLimits& limits,
+                                               const ProgressCallback& progress,
+                                               const StopToken& stop) {
+  // Shared, as tasks of the pool must be copyable.
+  auto promise = std::make_shared<std::promise<SearchResult>>();
+  std::future<SearchResult> result = promise->get_future();
+  const std::shared_ptr<std::atomic<bool>> state = stop.state;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->active.insert(state.get());
+  }
+
+  this->pool.Submit([this, board, limits, progress, state, promise]() {
+    try {
+      ::Search& search = *this->searches[ThreadPool::CurrentWorker()];
+      promise->set_value(
+        state->load() ? SearchResult() : search.Run(board, limits, progress, state.get()));
+    }
+    catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->active.erase(this->active.find(state.get()));
+  });
+  return result;
+}
+
+void SearchEngine::StopAll() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  for (std::atomic<bool>* state : this->active) {
+    state->store(true);
+  }
+}
+
+void SearchEngine::Clear() {
+  this->table->Clear();
+}
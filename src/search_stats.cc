@@ -0,0 +1,45 @@
+#include "search_stats.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+void SearchStats::Merge(const SearchStats& other) {
+  this->nodes += other.nodes;
+  this->qnodes += other.qnodes;
+  this->evaluations += other.evaluations;
+  this->cutoffs += other.cutoffs;
+  this->first_move_cutoffs += other.first_move_cutoffs;
+  this->table_probes += other.table_probes;
+  this->table_hits += other.table_hits;
+  this->table_cutoffs += other.table_cutoffs;
+  this->bitbase_hits += other.bitbase_hits;
+  this->selective_depth = std::max(this->selective_depth, other.selective_depth);
+}
+
+std::string SearchStats::ToJson() const {
+  std::ostringstream json;
+  json << "{\"nodes\":" << this->nodes
+       << ",\"qnodes\":" << this->qnodes
+       << ",\"evaluations\":" << this->evaluations
+       << ",\"cutoffs\":" << this->cutoffs
+       << ",\"first_move_cutoffs\":" << this->first_move_cutoffs
+       << ",\"first_move_cutoff_rate\":" << this->FirstMoveCutoffRate()
+       << ",\"table_probes\":" << this->table_probes
+       << ",\"table_hits\":" << this->table_hits
+       << ",\"table_hit_rate\":" << this->TableHitRate()
+       << ",\"table_cutoffs\":" << this->table_cutoffs
+       << ",\"bitbase_hits\":" << this->bitbase_hits
+       << ",\"selective_depth\":" << this->selective_depth
+       << ",\"iterations\":[";
+  for (size_t i = 0; i < this->iterations.size(); i++) {
+    const Iteration& iteration = this->iterations[i];
+    json << (i > 0 ? "," : "")
+         << "{\"depth\":" << iteration.depth
+         << ",\"nodes\":" << iteration.nodes
+         << ",\"time_ms\":" << iteration.milliseconds
+         << ",\"branching_factor\":" << iteration.branching_factor << '}';
+  }
+  json << "]}";
+  return json.str();
+}
@@ -0,0 +1,368 @@
+#include "server.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "board.h"
+#include "json.h"
+#include "moves.h"
+#include "search.h"
+#include "socket.h"
+#include "thread_pool.h"
+#include "transposition.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Most lines a request may ask for, more than the legal moves of any
+// position.
+constexpr int64_t kMaxMultiPv = 256;
+
+// Largest table a fresh request may ask for.
+constexpr int64_t kMaxFreshHashMegabytes = 4096;
+
+struct Request {
+  std::string id;
+  std::string fen;
+  Board board;
+  SearchLimits limits;
+  std::optional<Clock::time_point> deadline;
+  // Search from an empty table, for results that do not depend on earlier
+  // requests.
+  bool fresh = false;
+  // Size of the empty table, or 0 for the server's share per worker.
+  size_t hash_megabytes = 0;
+  std::atomic<bool> cancelled{false};
+};
+
+// A client connection. Owned jointly by its reader thread and the requests
+// in flight, so that the socket stays open until the last response is sent.
+class Connection {
+ public:
+  explicit Connection(int fd) : fd(fd) {}
+  ~Connection() {
+    close(this->fd);
+  }
+
+  void Send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(this->write_mutex);
+    SendAll(this->fd, line + "\n");
+  }
+
+  const int fd;
+  std::mutex mutex;
+  // Requests waiting or running, by id. Requests without an id can not be
+  // cancelled, and there may be any number of them.
+  std::multimap<std::string, std::shared_ptr<Request>> requests;
+
+ private:
+  std::mutex write_mutex;
+};
+
+std::string ErrorResponse(const std::string& id, const std::string& error) {
+  return "{\"id\":\"" + JsonEscape(id) + "\",\"error\":\"" + JsonEscape(error) + "\"}";
+}
+
+std::string ResultResponse(const Request& request, const SearchResult& result,
+                           double milliseconds, bool cached) {
+  std::ostringstream response;
+  response << "{\"id\":\"" << JsonEscape(request.id) << '"'
+           << ",\"fen\":\"" << JsonEscape(request.fen) << '"'
+           << ",\"score\":" << result.score
+           << ",\"best_move\":\""
+           << (result.best_move.has_value() ? MoveToString(*result.best_move) : "") << '"'
+           << ",\"pv\":\"";
+  for (size_t i = 0; i < result.pv.size(); i++) {
+    response << (i > 0 ? " " : "") << MoveToString(result.pv[i]);
+  }
+  response << '"';
+  if (request.limits.multi_pv > 1) {
+    response << ",\"lines\":[";
+    for (size_t i = 0; i < result.lines.size(); i++) {
+      const SearchLine& line = result.lines[i];
+      response << (i > 0 ? "," : "") << "{\"move\":\"" << MoveToString(line.move) << '"'
+               << ",\"score\":" << line.score << ",\"pv\":\"";
+      for (size_t j = 0; j < line.pv.size(); j++) {
+        response << (j > 0 ? " " : "") << MoveToString(line.pv[j]);
+      }
+      response << "\"}";
+    }
+    response << ']';
+  }
+  response << ",\"depth\":" << result.depth
+           << ",\"nodes\":" << result.nodes
+           << ",\"time_ms\":" << static_cast<uint64_t>(milliseconds)
+           << ",\"cached\":" << (cached ? "true" : "false") << '}';
+  return response.str();
+}
+
+// Returns the numeric member `name`, or `fallback` if absent or malformed.
+int64_t GetNumber(const JsonObject& object, const std::string& name, int64_t fallback) {
+  const auto it = object.find(name);
+  if (it == object.end()) {
+    return fallback;
+  }
+  try {
+    return std::stoll(it->second);
+  }
+  catch (const std::exception&) {
+    return fallback;
+  }
+}
+
+class AnalysisServer {
+ public:
+  explicit AnalysisServer(const ServerOptions& options)
+    : options(options),
+      table(options.hash_file.empty()
+              ? std::make_shared<TranspositionTable>(options.hash_megabytes)
+              : TranspositionTable::Map(options.hash_file, options.hash_megabytes)),
+      pool(options.threads) {
+    // All workers share one table, so that a position analysed by any of
+    // them speeds up related positions on all others.
+    for (int i = 0; i < this->pool.Size(); i++) {
+      this->searches.push_back(std::make_unique<Search>(this->table));
+    }
+    this->private_searches.resize(this->pool.Size());
+  }
+
+  void Serve(int listen_fd) {
+    while (true) {
+      const int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd < 0) {
+        continue;
+      }
+      // Connection threads run for as long as the server, which never
+      // returns, so they need not be joined.
+      std::thread([this, fd]() {
+        this->ReadRequests(std::make_shared<Connection>(fd));
+      }).detach();
+    }
+  }
+
+ private:
+  void ReadRequests(const std::shared_ptr<Connection>& connection) {
+    LineReader reader(connection->fd);
+    std::string line;
+    while (reader.ReadLine(line)) {
+      if (line.find_first_not_of(" \t") != std::string::npos) {
+        this->HandleLine(connection, line);
+      }
+    }
+
+    // Nobody is left to read the results.
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    for (const auto& [id, request] : connection->requests) {
+      request->cancelled.store(true);
+    }
+  }
+
+  void HandleLine(const std::shared_ptr<Connection>& connection, const std::string& line) {
+    const Clock::time_point arrival = Clock::now();
+    JsonObject object;
+    if (!ParseJsonObject(line, object)) {
+      connection->Send(ErrorResponse("", "invalid request"));
+      return;
+    }
+
+    if (object.count("cancel") != 0) {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      const auto it = connection->requests.find(object["cancel"]);
+      if (it != connection->requests.end() && !it->first.empty()) {
+        it->second->cancelled.store(true);
+      }
+      return;
+    }
+
+    auto request = std::make_shared<Request>();
+    request->id = object["id"];
+    request->fen = object["fen"];
+    try {
+      request->board = Board::FromFEN(request->fen);
+    }
+    catch (const std::exception& error) {
+      connection->Send(ErrorResponse(request->id, std::string("invalid position: ") + error.what()));
+      return;
+    }
+
+    request->limits.nodes = GetNumber(object, "nodes", 0);
+    request->limits.movetime = GetNumber(object, "movetime", 0);
+    // With only a node or time limit, search as deep as the limit allows.
+    const bool limited = request->limits.nodes > 0 || request->limits.movetime > 0;
+    request->limits.depth = static_cast<int>(
+      GetNumber(object, "depth", limited ? kMaxDepth : this->options.depth));
+    request->limits.multi_pv = static_cast<int>(
+      std::clamp<int64_t>(GetNumber(object, "multipv", 1), 1, kMaxMultiPv));
+    request->fresh = object["fresh"] == "true";
+    request->hash_megabytes = static_cast<size_t>(
+      std::clamp<int64_t>(GetNumber(object, "hash", 0), 0, kMaxFreshHashMegabytes));
+    const int64_t deadline = GetNumber(object, "deadline", 0);
+    if (deadline > 0) {
+      request->deadline = arrival + std::chrono::milliseconds(deadline);
+    }
+
+    {
+      // Ids of requests in flight must be unique, so that cancelling
+      // reaches the right request.
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      if (!request->id.empty() && connection->requests.count(request->id) != 0) {
+        connection->Send(ErrorResponse(request->id, "duplicate id"));
+        return;
+      }
+      if (this->in_flight.fetch_add(1) >= this->options.max_queue) {
+        this->in_flight.fetch_sub(1);
+        connection->Send(ErrorResponse(request->id, "busy"));
+        return;
+      }
+      connection->requests.emplace(request->id, request);
+    }
+    this->pool.Submit([this, connection, request]() {
+      connection->Send(this->Analyse(*request));
+      {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        const auto [begin, end] = connection->requests.equal_range(request->id);
+        const auto it = std::find_if(begin, end, [&](const auto& entry) {
+          return entry.second == request;
+        });
+        if (it != end) {
+          connection->requests.erase(it);
+        }
+      }
+      this->in_flight.fetch_sub(1);
+    });
+  }
+
+  // Runs a request on the calling worker and returns its response.
+  std::string Analyse(Request& request) {
+    const Clock::time_point start = Clock::now();
+    if (request.cancelled.load()) {
+      return ErrorResponse(request.id, "cancelled");
+    }
+    SearchLimits limits = request.limits;
+    if (request.deadline.has_value()) {
+      const int64_t remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        *request.deadline - start).count();
+      if (remaining <= 0) {
+        return ErrorResponse(request.id, "deadline exceeded");
+      }
+      limits.movetime = limits.movetime > 0 ? std::min(limits.movetime, remaining) : remaining;
+    }
+
+    // Only results of plain depth limited searches are reproducible enough
+    // to be reused. They are keyed by the position and the number of lines,
+    // mixed in so that a result is only reused for requests of as many lines.
+    const uint64_t key = request.board.Hash() ^ (limits.multi_pv - 1) * 0x9E3779B97F4A7C15ull;
+    const bool cacheable = limits.nodes == 0 && request.limits.movetime == 0 && !request.fresh;
+    if (cacheable) {
+      if (const std::optional<SearchResult> cached = this->FindCached(key, limits.depth)) {
+        return ResultResponse(request, *cached, 0, true);
+      }
+    }
+
+    const int worker = ThreadPool::CurrentWorker();
+    PrivateSearch& private_search = this->private_searches[worker];
+    if (request.fresh) {
+      const size_t megabytes = request.hash_megabytes > 0
+        ? request.hash_megabytes
+        : std::max<size_t>(this->options.hash_megabytes / this->pool.Size(), 1);
+      if (private_search.search == nullptr || private_search.megabytes != megabytes) {
+        private_search.search.reset();
+        private_search.search = std::make_unique<Search>(megabytes);
+        private_search.megabytes = megabytes;
+      }
+      private_search.search->Clear();
+    }
+    Search& search = request.fresh ? *private_search.search : *this->searches[worker];
+    const SearchResult result = search.Run(request.board, limits, nullptr, &request.cancelled);
+    if (request.cancelled.load()) {
+      return ErrorResponse(request.id, "cancelled");
+    }
+    if (result.depth == 0) {
+      // Stopped before completing an iteration, by whichever limit ran out.
+      if (request.deadline.has_value() && Clock::now() >= *request.deadline) {
+        return ErrorResponse(request.id, "deadline exceeded");
+      }
+      return ErrorResponse(
+        request.id, request.limits.nodes > 0 && result.nodes >= request.limits.nodes
+                      ? "node limit too small" : "movetime too small");
+    }
+    if (cacheable && result.depth >= limits.depth) {
+      this->StoreCached(key, result);
+    }
+    const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    return ResultResponse(request, result, elapsed.count(), false);
+  }
+
+  // Returns a remembered result for the position at least `depth` deep.
+  std::optional<SearchResult> FindCached(uint64_t key, int depth) {
+    std::lock_guard<std::mutex> lock(this->cache_mutex);
+    const auto it = this->cache.find(key);
+    if (it == this->cache.end() || it->second.depth < depth) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  void StoreCached(uint64_t key, const SearchResult& result) {
+    if (this->options.cache_size == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(this->cache_mutex);
+    const auto [it, inserted] = this->cache.emplace(key, result);
+    if (!inserted) {
+      if (it->second.depth < result.depth) {
+        it->second = result;
+      }
+      return;
+    }
+    // Evict the oldest results first.
+    this->cache_order.push_back(key);
+    if (this->cache_order.size() > this->options.cache_size) {
+      this->cache.erase(this->cache_order.front());
+      this->cache_order.pop_front();
+    }
+  }
+
+  const ServerOptions options;
+  std::shared_ptr<TranspositionTable> table;
+  ThreadPool pool;
+  // One search per worker, indexed by ThreadPool::CurrentWorker().
+  std::vector<std::unique_ptr<Search>> searches;
+  // Searches with a table of their own for fresh requests, allocated on
+  // first use and again when a request asks for another size.
+  struct PrivateSearch {
+    std::unique_ptr<Search> search;
+    size_t megabytes = 0;
+  };
+  std::vector<PrivateSearch> private_searches;
+  // Requests accepted but not yet answered.
+  std::atomic<size_t> in_flight{0};
+
+  std::mutex cache_mutex;
+  std::unordered_map<uint64_t, SearchResult> cache;
+  std::deque<uint64_t> cache_order;
+};
+
+}  // namespace
+
+void RunServer(const ServerOptions& options) {
+  const int listen_fd = ListenOn(options.address);
+  AnalysisServer server(options);
+  server.Serve(listen_fd);
+}
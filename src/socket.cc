@@ -0,0 +1,175 @@
+#include "socket.h"
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr char kUnixPrefix[] = "unix:";
+
+bool IsUnixAddress(const std::string& address) {
+  return address.compare(0, strlen(kUnixPrefix), kUnixPrefix) == 0;
+}
+
+sockaddr_un UnixAddress(const std::string& address) {
+  const std::string path = address.substr(strlen(kUnixPrefix));
+  sockaddr_un unix_address = {};
+  if (path.empty() || path.size() >= sizeof(unix_address.sun_path)) {
+    throw std::runtime_error("invalid socket path: " + path);
+  }
+  unix_address.sun_family = AF_UNIX;
+  memcpy(unix_address.sun_path, path.c_str(), path.size() + 1);
+  return unix_address;
+}
+
+// Resolves a "[host:]port" address. The result must be freed with
+// freeaddrinfo().
+addrinfo* ResolveTcp(const std::string& address, bool passive) {
+  const size_t colon = address.rfind(':');
+  const std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+  const std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  addrinfo* result = nullptr;
+  const int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+  if (error != 0) {
+    throw std::runtime_error("cannot resolve " + address + ": " + gai_strerror(error));
+  }
+  return result;
+}
+
+[[noreturn]] void ThrowSystemError(const std::string& what, const std::string& address) {
+  throw std::runtime_error(what + " " + address + ": " + strerror(errno));
+}
+
+}  // namespace
+
+int ListenOn(const std::string& address) {
+  if (IsUnixAddress(address)) {
+    const sockaddr_un unix_address = UnixAddress(address);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      ThrowSystemError("cannot create socket for", address);
+    }
+    unlink(unix_address.sun_path);
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&unix_address), sizeof(unix_address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+      close(fd);
+      ThrowSystemError("cannot listen on", address);
+    }
+    return fd;
+  }
+
+  addrinfo* addresses = ResolveTcp(address, true);
+  int fd = -1;
+  for (addrinfo* info = addresses; info != nullptr && fd < 0; info = info->ai_next) {
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    const int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, info->ai_addr, info->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) {
+    ThrowSystemError("cannot listen on", address);
+  }
+  return fd;
+}
+
+int ConnectTo(const std::string& address) {
+  if (IsUnixAddress(address)) {
+    const sockaddr_un unix_address = UnixAddress(address);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      ThrowSystemError("cannot create socket for", address);
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&unix_address), sizeof(unix_address)) != 0) {
+      close(fd);
+      ThrowSystemError("cannot connect to", address);
+    }
+    return fd;
+  }
+
+  addrinfo* addresses = ResolveTcp(address, false);
+  int fd = -1;
+  for (addrinfo* info = addresses; info != nullptr && fd < 0; info = info->ai_next) {
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd >= 0 && connect(fd, info->ai_addr, info->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) {
+    ThrowSystemError("cannot connect to", address);
+  }
+  return fd;
+}
+
+bool SendAll(int fd, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    // No SIGPIPE if the peer has closed the connection.
+    const ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    sent += count;
+  }
+  return true;
+}
+
+bool LineReader::ReadLine(std::string& line, int timeout_ms) {
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (true) {
+    const size_t newline = this->buffer.find('\n');
+    if (newline != std::string::npos) {
+      line = this->buffer.substr(0, newline);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      this->buffer.erase(0, newline + 1);
+      return true;
+    }
+
+    if (timeout_ms >= 0) {
+      const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+      pollfd poll_fd = {this->fd, POLLIN, 0};
+      if (remaining <= 0 || poll(&poll_fd, 1, static_cast<int>(remaining)) <= 0) {
+        return false;
+      }
+    }
+
+    char data[4096];
+    const ssize_t count = recv(this->fd, data, sizeof(data), 0);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      this->closed = true;
+      return false;
+    }
+    this->buffer.append(data, count);
+  }
+}
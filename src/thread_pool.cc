@@ -0,0 +1,115 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace {
+
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads) {
+  num_threads = std::max(num_threads, 1);
+  for (int i = 0; i < num_threads; i++) {
+    this->queues.push_back(std::make_unique<Queue>());
+  }
+  for (int i = 0; i < num_threads; i++) {
+    this->threads.emplace_back([this, i]() { this->WorkerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  this->Wait();
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->shutdown = true;
+  }
+  this->wake.notify_all();
+  for (std::thread& thread : this->threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  size_t index = current_pool == this ? current_worker : 0;
+  {
+    // Count the task before it becomes visible, so that the counters never
+    // drop below zero when it is popped.
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (current_pool != this) {
+      index = this->next_queue++ % this->queues.size();
+    }
+    this->queued++;
+    this->pending++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->queues[index]->mutex);
+    this->queues[index]->tasks.push_back(std::move(task));
+  }
+  this->wake.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->idle.wait(lock, [this]() { return this->pending == 0; });
+}
+
+int ThreadPool::CurrentWorker() {
+  return current_worker;
+}
+
+bool ThreadPool::TryPop(int index, std::function<void()>& task) {
+  const int size = static_cast<int>(this->queues.size());
+  for (int i = 0; i < size; i++) {
+    Queue& queue = *this->queues[(index + i) % size];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      // Newest task from our own queue, to stay deep in the current subtree.
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    else {
+      // Oldest task from another queue, which is likely the largest.
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int index) {
+  current_pool = this;
+  current_worker = index;
+
+  while (true) {
+    std::function<void()> task;
+    if (this->TryPop(index, task)) {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->queued--;
+      }
+      task();
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (--this->pending == 0) {
+        this->idle.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->wake.wait(lock, [this]() { return this->shutdown || this->queued > 0; });
+    if (this->shutdown && this->queued == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#include "trace.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "mapped_file.h"
+
+namespace {
+
+// Records written per fwrite() call.
+constexpr size_t kWriteBuffer = 1 << 16;
+
+}  // namespace
+
+const char* TraceReasonName(TraceReason reason) {
+  switch (reason) {
+    case TraceReason::SEARCHED: return "searched";
+    case TraceReason::CUTOFF: return "cutoff";
+    case TraceReason::TABLE: return "table";
+    case TraceReason::BITBASE: return "bitbase";
+    case TraceReason::FIFTY_MOVES: return "fifty-moves";
+    case TraceReason::STAND_PAT: return "stand-pat";
+    case TraceReason::CHECKMATE: return "checkmate";
+    case TraceReason::STALEMATE: return "stalemate";
+    case TraceReason::STOPPED: return "stopped";
+  }
+  return "unknown";
+}
+
+TraceWriter::TraceWriter(const std::string& path)
+  : path(path), file(fopen(path.c_str(), "wb")) {
+  if (this->file == nullptr) {
+    throw std::runtime_error("cannot create " + path + ": " + strerror(errno));
+  }
+  fwrite(kTraceFileMagic, sizeof(kTraceFileMagic), 1, this->file);
+  this->buffer.reserve(kWriteBuffer);
+}
+
+TraceWriter::~TraceWriter() {
+  if (this->file != nullptr) {
+    this->Flush();
+    fclose(this->file);
+  }
+}
+
+void TraceWriter::Close() {
+  this->Flush();
+  const bool failed = ferror(this->file) != 0;
+  const bool close_failed = fclose(this->file) != 0;
+  this->file = nullptr;
+  if (failed || close_failed) {
+    throw std::runtime_error("cannot write " + this->path);
+  }
+}
+
+void TraceWriter::Flush() {
+  if (!this->buffer.empty()) {
+    fwrite(this->buffer.data(), sizeof(TraceRecord), this->buffer.size(), this->file);
+    this->buffer.clear();
+  }
+}
+
+TraceReader::TraceReader(const std::string& path) : file(path) {
+  if (this->file.Size() < sizeof(kTraceFileMagic) ||
+      memcmp(this->file.Data(), kTraceFileMagic, sizeof(kTraceFileMagic)) != 0) {
+    throw std::runtime_error(path + " is not a search trace");
+  }
+  // A trace cut short, e.g. by a crash, ends with a partial record.
+  this->count = (this->file.Size() - sizeof(kTraceFileMagic)) / sizeof(TraceRecord);
+  this->records = reinterpret_cast<const TraceRecord*>(
+    this->file.Data() + sizeof(kTraceFileMagic));
+}
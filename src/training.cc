@@ -0,0 +1,106 @@
+#include "training.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+namespace {
+
+// Records written per fwrite() call.
+constexpr size_t kWriteBuffer = 4096;
+
+}  // namespace
+
+TrainingWriter::TrainingWriter(const std::string& path, std::chrono::seconds flush_interval)
+  : path(path), flush_interval(flush_interval), last_flush(std::chrono::steady_clock::now()) {
+  struct stat status;
+  if (stat(path.c_str(), &status) == 0 && status.st_size > 0) {
+    // Continue an earlier run.
+    char magic[sizeof(kTrainingFileMagic)] = {};
+    FILE* existing = fopen(path.c_str(), "rb");
+    const bool valid = (
+      existing != nullptr && fread(magic, sizeof(magic), 1, existing) == 1 &&
+      memcmp(magic, kTrainingFileMagic, sizeof(magic)) == 0);
+    if (existing != nullptr) {
+      fclose(existing);
+    }
+    if (!valid) {
+      throw std::runtime_error(path + " is not a training file");
+    }
+    this->count = (status.st_size - sizeof(kTrainingFileMagic)) / sizeof(TrainingRecord);
+    const off_t size = sizeof(kTrainingFileMagic) + this->count * sizeof(TrainingRecord);
+    if (size != status.st_size && truncate(path.c_str(), size) != 0) {
+      throw std::runtime_error("cannot truncate " + path + ": " + strerror(errno));
+    }
+    this->file = fopen(path.c_str(), "ab");
+  }
+  else {
+    this->file = fopen(path.c_str(), "wb");
+    if (this->file != nullptr) {
+      fwrite(kTrainingFileMagic, sizeof(kTrainingFileMagic), 1, this->file);
+    }
+  }
+  if (this->file == nullptr) {
+    throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+  }
+  this->buffer.reserve(kWriteBuffer);
+}
+
+TrainingWriter::~TrainingWriter() {
+  if (this->file != nullptr) {
+    // Errors can not be reported from a destructor; call Close() to see them.
+    this->Flush();
+    fclose(this->file);
+  }
+}
+
+void TrainingWriter::Write(const TrainingRecord& record) {
+  this->buffer.push_back(record);
+  this->count++;
+  if (this->buffer.size() == kWriteBuffer ||
+      std::chrono::steady_clock::now() - this->last_flush >= this->flush_interval) {
+    this->Flush();
+  }
+}
+
+void TrainingWriter::Flush() {
+  if (!this->buffer.empty()) {
+    // Failures are sticky and reported by Close().
+    fwrite(this->buffer.data(), sizeof(TrainingRecord), this->buffer.size(), this->file);
+    this->buffer.clear();
+  }
+  fflush(this->file);
+  this->last_flush = std::chrono::steady_clock::now();
+}
+
+void TrainingWriter::Close() {
+  if (this->file == nullptr) {
+    return;
+  }
+  this->Flush();
+  const bool failed = ferror(this->file) != 0;
+  const bool close_failed = fclose(this->file) != 0;
+  this->file = nullptr;
+  if (failed || close_failed) {
+    throw std::runtime_error("cannot write " + this->path);
+  }
+}
+
+TrainingReader::TrainingReader(const std::string& path) : file(path) {
+  if (this->file.Size() < sizeof(kTrainingFileMagic) ||
+      memcmp(this->file.Data(), kTrainingFileMagic, sizeof(kTrainingFileMagic)) != 0) {
+    throw std::runtime_error(path + " is not a training file");
+  }
+  // Mappings are page aligned, so the records after the 8-byte magic are
+  // aligned as well.
+  this->records = reinterpret_cast<const TrainingRecord*>(
+    this->file.Data() + sizeof(kTrainingFileMagic));
+  this->count = (this->file.Size() - sizeof(kTrainingFileMagic)) / sizeof(TrainingRecord);
+}
@@ -0,0 +1,210 @@
+#include "transposition.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "board.h"
+#include "evaluation.h"
+#include "moves.h"
+
+namespace {
+
+constexpr char kTableFileMagic[8] = {'C', 'E', 'T', 'A', 'B', 'L', 'E', '1'};
+
+constexpr char kStartPosition[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct TableFileHeader {
+  char magic[8];
+  uint64_t version;
+  // Hash of the initial position and of the evaluation parameters.
+  uint64_t fingerprint;
+  uint64_t slots;
+  uint64_t slot_bytes;
+  uint8_t reserved[24];
+};
+static_assert(sizeof(TableFileHeader) == 64, "the header keeps the slots aligned");
+
+uint64_t Fingerprint() {
+  return Board::FromFEN(kStartPosition).Hash() ^ EvaluationFingerprint();
+}
+
+TableFileHeader MakeHeader(size_t slots, size_t slot_bytes) {
+  TableFileHeader header = {};
+  memcpy(header.magic, kTableFileMagic, sizeof(header.magic));
+  header.version = kTableVersion;
+  header.fingerprint = Fingerprint();
+  header.slots = slots;
+  header.slot_bytes = slot_bytes;
+  return header;
+}
+
+// Throws std::runtime_error unless the file of `file_bytes` starting with
+// `header` holds a current table of `slots` slots.
+void CheckHeader(const TableFileHeader& header, size_t file_bytes, size_t slots,
+                 size_t slot_bytes, const std::string& path) {
+  if (file_bytes < sizeof(header) ||
+      memcmp(header.magic, kTableFileMagic, sizeof(header.magic)) != 0) {
+    throw std::runtime_error(path + " is not a saved hash table");
+  }
+  if (header.version != kTableVersion || header.fingerprint != Fingerprint()) {
+    throw std::runtime_error(path + " is stale, from another version of the engine");
+  }
+  if (header.slot_bytes != slot_bytes ||
+      file_bytes != sizeof(header) + header.slots * header.slot_bytes) {
+    throw std::runtime_error(path + " is truncated or corrupt");
+  }
+  if (header.slots != slots) {
+    throw std::runtime_error(
+      path + " holds a table of " + std::to_string((header.slots * slot_bytes) >> 20) +
+      " MB, not " + std::to_string((slots * slot_bytes) >> 20) + " MB");
+  }
+}
+
+// Returns the number of slots of a table of at most `megabytes`, a power
+// of two, so that the slot is found with a mask.
+size_t SlotsFor(size_t megabytes, size_t slot_bytes) {
+  size_t size = 1;
+  while (size * 2 * slot_bytes <= std::max<size_t>(megabytes, 1) << 20) {
+    size *= 2;
+  }
+  return size;
+}
+
+// Layout of the data word:
+//   bits  0-31: score
+//   bits 32-39: depth
+//   bits 40-41: bound
+//   bits 42-59: packed move
+//   bit     60: move is present
+constexpr int kDepthShift = 32;
+constexpr int kBoundShift = 40;
+constexpr int kMoveShift = 42;
+constexpr uint64_t kHasMove = uint64_t{1} << 60;
+
+uint64_t Encode(const TableEntry& entry) {
+  const uint8_t depth = static_cast<uint8_t>(std::clamp(entry.depth, 0, 255));
+  uint64_t data = static_cast<uint32_t>(entry.score);
+  data |= static_cast<uint64_t>(depth) << kDepthShift;
+  data |= static_cast<uint64_t>(entry.bound) << kBoundShift;
+  if (entry.move.has_value()) {
+    data |= static_cast<uint64_t>(PackMove(*entry.move)) << kMoveShift;
+    data |= kHasMove;
+  }
+  return data;
+}
+
+TableEntry Decode(uint64_t data) {
+  TableEntry entry;
+  entry.score = static_cast<int32_t>(static_cast<uint32_t>(data));
+  entry.depth = static_cast<uint8_t>(data >> kDepthShift);
+  entry.bound = static_cast<Bound>((data >> kBoundShift) & 3);
+  if (data & kHasMove) {
+    entry.move = UnpackMove(static_cast<uint32_t>(data >> kMoveShift) & 0x3FFFF);
+  }
+  return entry;
+}
+
+}  // namespace
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+  this->size = SlotsFor(megabytes, sizeof(Slot));
+  this->owned = std::make_unique<Slot[]>(this->size);
+  this->slots = this->owned.get();
+  this->Clear();
+}
+
+TranspositionTable::~TranspositionTable() {
+  if (this->mapping != nullptr) {
+    munmap(this->mapping, this->mapping_bytes);
+  }
+}
+
+std::shared_ptr<TranspositionTable> TranspositionTable::Map(const std::string& path,
+                                                            size_t megabytes) {
+  const size_t slots = SlotsFor(megabytes, sizeof(Slot));
+  const size_t bytes = sizeof(TableFileHeader) + slots * sizeof(Slot);
+  const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+  }
+  const auto fail = [fd, &path](const std::string& message) {
+    close(fd);
+    throw std::runtime_error(message);
+  };
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    fail("cannot stat " + path + ": " + strerror(errno));
+  }
+  if (status.st_size == 0) {
+    // A new file reads as zeros, which are empty slots.
+    const TableFileHeader header = MakeHeader(slots, sizeof(Slot));
+    if (ftruncate(fd, bytes) != 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+      fail("cannot create " + path + ": " + strerror(errno));
+    }
+  }
+  else {
+    TableFileHeader header = {};
+    if (pread(fd, &header, sizeof(header), 0) < 0) {
+      fail("cannot read " + path + ": " + strerror(errno));
+    }
+    CheckHeader(header, status.st_size, slots, sizeof(Slot), path);
+  }
+  void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    fail("cannot map " + path + ": " + strerror(errno));
+  }
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+
+  std::shared_ptr<TranspositionTable> table(new TranspositionTable());
+  table->mapping = mapping;
+  table->mapping_bytes = bytes;
+  table->size = slots;
+  table->slots = reinterpret_cast<Slot*>(static_cast<char*>(mapping) + sizeof(TableFileHeader));
+  return table;
+}
+
+std::optional<TableEntry> TranspositionTable::Probe(uint64_t key) const {
+  const Slot& slot = this->slots[key & (this->size - 1)];
+  const uint64_t data = slot.data.load(std::memory_order_relaxed);
+  const uint64_t check = slot.check.load(std::memory_order_relaxed);
+  if ((check ^ data) != key || data == 0) {
+    return std::nullopt;
+  }
+  return Decode(data);
+}
+
+void TranspositionTable::Store(uint64_t key, const TableEntry& entry) {
+  Slot& slot = this->slots[key & (this->size - 1)];
+  const uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+  const uint64_t old_check = slot.check.load(std::memory_order_relaxed);
+  if (
+    (old_check ^ old_data) == key &&
+    static_cast<int>(static_cast<uint8_t>(old_data >> kDepthShift)) > entry.depth
+  ) {
+    // Keep the result of the deeper search.
+    return;
+  }
+  const uint64_t data = Encode(entry);
+  slot.check.store(key ^ data, std::memory_order_relaxed);
+  slot.data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::Clear() {
+  for (size_t i = 0; i < this->size; i++) {
+    this->slots[i].check.store(0, std::memory_order_relaxed);
+    this->slots[i].data.store(0, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,422 @@
+#include "uci.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "bitbase.h"
+#include "board.h"
+#include "moves.h"
+#include "polyglot.h"
+#include "search.h"
+#include "transposition.h"
+
+namespace {
+
+constexpr char kStartPosition[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Formats a score from white's point of view as a UCI score from the point
+// of view of the side to move.
+std::string FormatScore(int score, bool white_to_move, size_t pv_length) {
+  if (score == std::numeric_limits<int>::max() || score == std::numeric_limits<int>::min()) {
+    // Mate scores carry no distance, the length of the line is the best guess.
+    const bool winning = (score == std::numeric_limits<int>::max()) == white_to_move;
+    const int moves = static_cast<int>((pv_length + 1) / 2);
+    return "mate " + std::to_string(winning ? moves : -moves);
+  }
+  return "cp " + std::to_string(white_to_move ? score : -score);
+}
+
+// Parses the value of a spin option, clamped to the range it advertises.
+// Returns nullopt unless the value is a number.
+std::optional<int64_t> ParseSpin(const std::string& value, int64_t min, int64_t max) {
+  int64_t number = 0;
+  const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+  if (error == std::errc::result_out_of_range) {
+    return value[0] == '-' ? min : max;
+  }
+  if (error != std::errc() || end != value.data() + value.size()) {
+    return std::nullopt;
+  }
+  return std::clamp(number, min, max);
+}
+
+class UciSession {
+ public:
+  explicit UciSession(std::ostream& output)
+    : output(output), search(std::make_unique<Search>(16)) {
+    this->position = Board::FromFEN(kStartPosition);
+  }
+  ~UciSession() {
+    this->StopSearch();
+  }
+
+  // Handles one line of input. Returns false when the session should end.
+  bool Handle(const std::string& line) {
+    std::istringstream tokens(line);
+    std::string command;
+    tokens >> command;
+
+    if (command == "uci") {
+      this->Send(
+        "id name chess-engine\n"
+        "id author Jonas Nylund\n"
+        "option name Hash type spin default 16 min 1 max 65536\n"
+        "option name HashFile type string default <empty>\n"
+        "option name Threads type spin default 1 min 1 max 512\n"
+        "option name Ponder type check default false\n"
+        "option name MultiPV type spin default 1 min 1 max 256\n"
+        "option name BitbasePath type string default bitbases\n"
+        "option name BookFile type string default <empty>\n"
+        "option name BookSelection type combo default Weighted var Weighted var Best\n"
+        "uciok");
+    }
+    else if (command == "isready") {
+      this->Send("readyok");
+    }
+    else if (command == "ucinewgame") {
+      this->StopSearch();
+      // A table kept in a file is meant to outlive games and sessions.
+      if (this->hash_file.empty()) {
+        this->search->Clear();
+      }
+    }
+    else if (command == "setoption") {
+      this->SetOption(tokens);
+    }
+    else if (command == "position") {
+      this->SetPosition(tokens);
+    }
+    else if (command == "go") {
+      this->Go(tokens);
+    }
+    else if (command == "stop") {
+      this->StopSearch();
+    }
+    else if (command == "ponderhit") {
+      this->PonderHit();
+    }
+    else if (command == "quit") {
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  void Send(const std::string& message) {
+    std::lock_guard<std::mutex> lock(this->output_mutex);
+    this->output << message << std::endl;
+  }
+
+  void SetOption(std::istringstream& tokens) {
+    // setoption name <name> value <value>, where the value may contain
+    // spaces, e.g. in paths.
+    std::string token;
+    std::string name;
+    tokens >> token >> name;
+    while (tokens >> token && token != "value") {
+      name += " " + token;
+    }
+    std::string value;
+    std::getline(tokens >> std::ws, value);
+    if (name == "Hash" || name == "Threads" || name == "MultiPV") {
+      const int64_t max = name == "Hash" ? 65536 : name == "Threads" ? 512 : 256;
+      const std::optional<int64_t> number = ParseSpin(value, 1, max);
+      if (!number.has_value()) {
+        this->Send("info string invalid value for " + name + ": " + value);
+      }
+      else if (name == "Hash") {
+        this->StopSearch();
+        this->hash_megabytes = *number;
+        this->CreateSearch();
+      }
+      else if (name == "Threads") {
+        this->threads = *number;
+      }
+      else {
+        this->multi_pv = *number;
+      }
+    }
+    else if (name == "HashFile") {
+      this->StopSearch();
+      this->hash_file = value == "<empty>" ? "" : value;
+      this->CreateSearch();
+    }
+    else if (name == "BitbasePath") {
+      this->StopSearch();
+      const size_t loaded = LoadBitbases(value);
+      this->Send("info string " + std::to_string(loaded) + " bitbases loaded");
+    }
+    else if (name == "BookFile") {
+      this->book_path = value == "<empty>" ? "" : value;
+      this->LoadBook();
+    }
+    else if (name == "BookSelection") {
+      this->book_selection = value == "Best" ? BookSelection::BEST : BookSelection::WEIGHTED;
+    }
+  }
+
+  // Replaces the search by one with a table of the current size, mapped
+  // from the hash file if one is set.
+  void CreateSearch() {
+    this->search.reset();
+    if (!this->hash_file.empty()) {
+      try {
+        this->search = std::make_unique<Search>(
+          TranspositionTable::Map(this->hash_file, this->hash_megabytes));
+        return;
+      }
+      catch (const std::exception& error) {
+        this->Send(std::string("info string ") + error.what());
+      }
+    }
+    this->search = std::make_unique<Search>(this->hash_megabytes);
+  }
+
+  // Opens the book, if its file is set.
+  void LoadBook() {
+    this->book.reset();
+    if (this->book_path.empty()) {
+      return;
+    }
+    try {
+      this->book = std::make_unique<PolyglotBook>(this->book_path);
+    }
+    catch (const std::exception& error) {
+      this->Send(std::string("info string ") + error.what());
+    }
+  }
+
+  void SetPosition(std::istringstream& tokens) {
+    // position [startpos | fen <FEN>] [moves <move> ...]
+    std::string token;
+    tokens >> token;
+    std::string fen;
+    if (token == "startpos") {
+      fen = kStartPosition;
+      tokens >> token;
+    }
+    else if (token == "fen") {
+      while (tokens >> token && token != "moves") {
+        fen += (fen.empty() ? "" : " ") + token;
+      }
+    }
+    try {
+      this->position = Board::FromFEN(fen);
+    }
+    catch (const std::exception&) {
+      this->Send("info string invalid position");
+      return;
+    }
+
+    if (token != "moves") {
+      return;
+    }
+    while (tokens >> token) {
+      const std::optional<Move> move = MoveFromString(this->position, token);
+      if (!move.has_value()) {
+        this->Send("info string illegal move " + token);
+        return;
+      }
+      this->position.Move(move->from, move->to, move->promotion, move->castling);
+    }
+  }
+
+  void Go(std::istringstream& tokens) {
+    this->StopSearch();
+
+    SearchLimits limits;
+    limits.depth = kMaxDepth;
+    limits.threads = this->threads;
+    limits.multi_pv = this->multi_pv;
+    int64_t time_left[2] = {0, 0};
+    int64_t increment[2] = {0, 0};
+    int moves_to_go = 0;
+    bool infinite = true;
+    bool ponder = false;
+
+    std::string token;
+    while (tokens >> token) {
+      if (token == "depth") {
+        tokens >> limits.depth;
+        infinite = false;
+      }
+      else if (token == "nodes") {
+        tokens >> limits.nodes;
+        infinite = false;
+      }
+      else if (token == "movetime") {
+        tokens >> limits.movetime;
+        infinite = false;
+      }
+      else if (token == "wtime" || token == "btime") {
+        tokens >> time_left[token == "btime"];
+        infinite = false;
+      }
+      else if (token == "winc" || token == "binc") {
+        tokens >> increment[token == "binc"];
+      }
+      else if (token == "movestogo") {
+        tokens >> moves_to_go;
+      }
+      else if (token == "infinite") {
+        infinite = true;
+      }
+      else if (token == "ponder") {
+        ponder = true;
+      }
+    }
+    if (!infinite && !ponder && this->book != nullptr) {
+      // Book moves are played without searching.
+      const std::optional<Move> move =
+        this->book->Pick(this->position, this->book_selection, this->random);
+      if (move.has_value()) {
+        this->Send("info string book move");
+        this->Send("bestmove " + MoveToString(*move));
+        return;
+      }
+    }
+
+    const int side = this->position.WhiteToMove() ? 0 : 1;
+    if (time_left[side] > 0) {
+      const int64_t budget = AllocateTime(time_left[side], increment[side], moves_to_go);
+      limits.movetime = limits.movetime > 0 ? std::min(limits.movetime, budget) : budget;
+    }
+    // A search on the opponent's time runs without a clock until the
+    // opponent plays the expected move, see PonderHit().
+    this->deadline.store(0);
+    limits.deadline = &this->deadline;
+    this->ponder_movetime = ponder ? limits.movetime : 0;
+    if (ponder) {
+      limits.movetime = 0;
+    }
+
+    this->stop_token.store(false);
+    this->pondering = ponder;
+    const Board board = this->position;
+    this->search_thread = std::thread([this, board, limits, infinite]() {
+      this->SearchThread(board, limits, infinite);
+    });
+  }
+
+  // The opponent played the move pondered on: the search continues as a
+  // normal one, with the time it would have been given from now.
+  void PonderHit() {
+    {
+      std::lock_guard<std::mutex> lock(this->stop_mutex);
+      if (!this->pondering) {
+        return;
+      }
+      this->pondering = false;
+      if (this->ponder_movetime > 0) {
+        this->deadline.store(DeadlineAfter(this->ponder_movetime));
+      }
+    }
+    this->stop_cv.notify_all();
+  }
+
+  void SearchThread(const Board& board, const SearchLimits& limits, bool infinite) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto report = [&](const SearchResult& result) {
+      const int64_t milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+      // One line per best move, numbered when there are several.
+      for (size_t i = 0; i < result.lines.size(); i++) {
+        const SearchLine& line = result.lines[i];
+        std::ostringstream info;
+        info << "info depth " << result.depth;
+        if (limits.multi_pv > 1) {
+          info << " multipv " << i + 1;
+        }
+        info << " score " << FormatScore(line.score, board.WhiteToMove(), line.pv.size())
+             << " nodes " << result.nodes
+             << " time " << milliseconds
+             << " nps " << result.nodes * 1000 / std::max<int64_t>(milliseconds, 1)
+             << " pv";
+        for (const Move& move : line.pv) {
+          info << " " << MoveToString(move);
+        }
+        this->Send(info.str());
+      }
+    };
+    const SearchResult result = this->search->Run(board, limits, report, &this->stop_token);
+
+    {
+      // The best move may only be reported once the GUI asks for it, or
+      // the opponent has played the move pondered on.
+      std::unique_lock<std::mutex> lock(this->stop_mutex);
+      this->stop_cv.wait(lock, [this, infinite]() {
+        return this->stop_token.load() || (!infinite && !this->pondering);
+      });
+    }
+    std::string bestmove =
+      "bestmove " + (result.best_move.has_value() ? MoveToString(*result.best_move) : "0000");
+    if (result.pv.size() >= 2) {
+      // The expected reply, to search on the opponent's time.
+      bestmove += " ponder " + MoveToString(result.pv[1]);
+    }
+    this->Send(bestmove);
+  }
+
+  // Stops the running search, if any, and waits for it to report its move.
+  // A search pondering on a move the opponent did not play ends this way.
+  void StopSearch() {
+    {
+      std::lock_guard<std::mutex> lock(this->stop_mutex);
+      this->stop_token.store(true);
+      this->pondering = false;
+    }
+    this->stop_cv.notify_all();
+    if (this->search_thread.joinable()) {
+      this->search_thread.join();
+    }
+  }
+
+  std::ostream& output;
+  std::mutex output_mutex;
+
+  Board position;
+  std::unique_ptr<Search> search;
+  size_t hash_megabytes = 16;
+  std::string hash_file;
+  int threads = 1;
+  int multi_pv = 1;
+
+  std::string book_path;
+  std::unique_ptr<PolyglotBook> book;
+  BookSelection book_selection = BookSelection::WEIGHTED;
+  std::mt19937_64 random{std::random_device()()};
+
+  std::thread search_thread;
+  std::atomic<bool> stop_token{false};
+  std::mutex stop_mutex;
+  std::condition_variable stop_cv;
+  // Guarded by `stop_mutex`: whether the search runs on the opponent's
+  // time, and the time it is given on a ponder hit, or 0 for no limit.
+  bool pondering = false;
+  int64_t ponder_movetime = 0;
+  std::atomic<int64_t> deadline{0};
+};
+
+}  // namespace
+
+void RunUci(std::istream& input, std::ostream& output) {
+  UciSession session(output);
+  std::string line;
+  while (std::getline(input, line)) {
+    if (!session.Handle(line)) {
+      break;
+    }
+  }
+}
@@ -0,0 +1,267 @@
+// Microbenchmarks of the hot paths of the engine.
+//
+// Usage: microbench [--filter TEXT] [--samples N] [--time ms]
+//
+// Every benchmark runs an operation over a fixed suite of positions. After
+// a warmup, the number of iterations per sample is calibrated to take at
+// least the given time, and the median, minimum and spread of the samples
+// are reported, in nanoseconds per operation.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "evaluation.h"
+#include "moves.h"
+#include "search.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Openings, middlegames with castling and en passant rights, and endgames.
+constexpr const char* kPositions[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+  "rnbqkb1r/pp1p1ppp/4pn2/2pP4/2P5/8/PP2PPPP/RNBQKBNR w KQkq c6 0 4",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "2kr3r/pp1q1ppp/2n1bn2/3pp3/3P4/2PBPN2/PP1N1PPP/R2QK2R b KQ - 3 11",
+  "r1b2rk1/2q1bppp/p2ppn2/1p6/3BPP2/2NB1Q2/PPP3PP/2KR3R w - - 2 14",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "8/8/4kpp1/3p1b2/p6P/2B5/6P1/6K1 b - - 3 47",
+  "6k1/5p2/6p1/8/7p/8/6PP/6K1 b - - 0 1",
+  "8/3k4/8/8/8/2Q5/4K3/8 w - - 0 1",
+  "1r6/4k3/8/8/8/8/3K4/7R w - - 0 1",
+};
+
+struct Benchmark {
+  std::string name;
+  // Runs the operation over the suite once and returns the number of
+  // operations.
+  std::function<uint64_t()> run;
+};
+
+struct Statistics {
+  double median;
+  double min;
+  // Relative standard deviation in percent.
+  double spread;
+};
+
+// Keeps the compiler from optimising away values that are never used.
+template <typename T>
+inline void Consume(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Samples taken of slow benchmarks at least, and the time after which no
+// more are taken.
+constexpr int kMinSamples = 3;
+constexpr std::chrono::seconds kSampleBudget(5);
+
+// Returns the time per operation of `samples` runs of `iterations` passes.
+Statistics Measure(const Benchmark& benchmark, int iterations, int samples) {
+  std::vector<double> results;
+  const Clock::time_point deadline = Clock::now() + kSampleBudget;
+  for (int sample = 0; sample < samples; sample++) {
+    if (sample >= kMinSamples && Clock::now() >= deadline) {
+      break;
+    }
+    uint64_t operations = 0;
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+      operations += benchmark.run();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    results.push_back(elapsed.count() / std::max<uint64_t>(operations, 1));
+  }
+  std::sort(results.begin(), results.end());
+  double mean = 0;
+  for (const double result : results) {
+    mean += result / results.size();
+  }
+  double variance = 0;
+  for (const double result : results) {
+    variance += (result - mean) * (result - mean) / results.size();
+  }
+  return {results[results.size() / 2], results.front(), 100 * std::sqrt(variance) / mean};
+}
+
+// Finds the number of passes that takes at least `target` per sample,
+// which also warms up caches and branch predictors.
+int Calibrate(const Benchmark& benchmark, std::chrono::milliseconds target) {
+  int iterations = 1;
+  while (true) {
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+      benchmark.run();
+    }
+    if (Clock::now() - start >= target || iterations >= (1 << 24)) {
+      return iterations;
+    }
+    iterations *= 2;
+  }
+}
+
+std::vector<Benchmark> Benchmarks(const std::vector<Board>& boards) {
+  // Legal moves of each position, for playing them out.
+  std::vector<std::vector<Move>> moves;
+  for (const Board& board : boards) {
+    moves.emplace_back();
+    MoveIterator iterator(board);
+    while (const std::optional<Move> move = iterator.Next(true, true, true)) {
+      moves.back().push_back(*move);
+    }
+  }
+  std::vector<std::string> fens;
+  for (const Board& board : boards) {
+    fens.push_back(board.ToFEN());
+  }
+
+  const auto iterate = [&boards](bool non_capturing, bool capturing, bool checks) {
+    return [&boards, non_capturing, capturing, checks]() {
+      uint64_t count = 0;
+      for (const Board& board : boards) {
+        MoveIterator iterator(board);
+        while (const std::optional<Move> move = iterator.Next(non_capturing, capturing, checks)) {
+          Consume(*move);
+          count++;
+        }
+      }
+      return count;
+    };
+  };
+  const auto evaluate = [&boards](int depth) {
+    return [&boards, depth]() {
+      for (const Board& board : boards) {
+        Consume(Evaluate(&board, depth));
+      }
+      return static_cast<uint64_t>(boards.size());
+    };
+  };
+  // One search for all passes, cleared once per pass, so that the numbers
+  // are those of searching rather than of allocating and clearing tables.
+  const auto search = std::make_shared<Search>();
+  const auto run_search = [&boards, search](int depth) {
+    return [&boards, search, depth]() {
+      search->Clear();
+      SearchLimits limits;
+      limits.depth = depth;
+      for (const Board& board : boards) {
+        Consume(search->Run(board, limits).score);
+      }
+      return static_cast<uint64_t>(boards.size());
+    };
+  };
+
+  return {
+    {"Board::Move", [&boards, moves]() {
+      uint64_t count = 0;
+      for (size_t i = 0; i < boards.size(); i++) {
+        for (const Move& move : moves[i]) {
+          Board board = boards[i];
+          board.Move(move.from, move.to, move.promotion, move.castling);
+          Consume(board);
+          count++;
+        }
+      }
+      return count;
+    }},
+    {"IsAttacked", [&boards]() {
+      uint64_t count = 0;
+      for (const Board& board : boards) {
+        for (int8_t rank = 0; rank < 8; rank++) {
+          for (int8_t file = 0; file < 8; file++) {
+            Consume(IsAttacked(board, {.file = file, .rank = rank}, true));
+            Consume(IsAttacked(board, {.file = file, .rank = rank}, false));
+            count += 2;
+          }
+        }
+      }
+      return count;
+    }},
+    {"MoveIterator::Next (all)", iterate(true, true, true)},
+    {"MoveIterator::Next (captures)", iterate(false, true, false)},
+    {"MoveIterator::Next (captures, checks)", iterate(false, true, true)},
+    {"CountPieces", [&boards]() {
+      for (const Board& board : boards) {
+        Consume(CountPieces(&board));
+      }
+      return static_cast<uint64_t>(boards.size());
+    }},
+    {"Board::FromFEN", [fens]() {
+      for (const std::string& fen : fens) {
+        Consume(Board::FromFEN(fen));
+      }
+      return static_cast<uint64_t>(fens.size());
+    }},
+    {"Board::ToFEN", [&boards]() {
+      char fen[kMaxFENLength];
+      for (const Board& board : boards) {
+        Consume(board.ToFEN(fen));
+      }
+      return static_cast<uint64_t>(boards.size());
+    }},
+    {"Evaluate (depth 1)", evaluate(1)},
+    {"Evaluate (depth 2)", evaluate(2)},
+    {"Search::Run (depth 1)", run_search(1)},
+    {"Search::Run (depth 2)", run_search(2)},
+  };
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string filter;
+  int samples = 10;
+  int milliseconds = 50;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--filter") == 0) {
+      filter = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "--samples") == 0) {
+      samples = std::max(std::atoi(argv[i + 1]), 1);
+    }
+    else if (strcmp(argv[i], "--time") == 0) {
+      milliseconds = std::max(std::atoi(argv[i + 1]), 1);
+    }
+  }
+
+  std::vector<Board> boards;
+  for (const char* fen : kPositions) {
+    boards.push_back(Board::FromFEN(fen));
+  }
+
+  std::cout << std::left << std::setw(40) << "benchmark" << std::right
+            << std::setw(12) << "ns/op" << std::setw(12) << "min"
+            << std::setw(10) << "+/-" << std::setw(14) << "ops/s" << std::endl;
+  for (const Benchmark& benchmark : Benchmarks(boards)) {
+    if (benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    const int iterations = Calibrate(benchmark, std::chrono::milliseconds(milliseconds));
+    const Statistics statistics = Measure(benchmark, iterations, samples);
+    std::cout << std::left << std::setw(40) << benchmark.name << std::right << std::fixed
+              << std::setprecision(1)
+              << std::setw(12) << statistics.median
+              << std::setw(12) << statistics.min
+              << std::setw(9) << statistics.spread << '%'
+              << std::setw(14) << static_cast<uint64_t>(1e9 / statistics.median)
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,237 @@
+// Generates training positions from self-play games, see training.h.
+//
+// Usage: datagen <file> [--positions N] [--threads N] [--nodes N]
+//                [--hash MB] [--openings FILE] [--random-plies N]
+//                [--seed N] [--flush SECONDS]
+//
+// Each game starts from one of the openings, or the initial position,
+// followed by --random-plies random moves, and every move is searched with
+// --nodes nodes. Positions are recorded with their score and the result of
+// the game, unless the side to move is in check, the move played captures
+// or promotes, or the score is a mate. Runs until the file holds
+// --positions records; run it again on the same file to continue.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitbase.h"
+#include "board.h"
+#include "fen.h"
+#include "match.h"
+#include "moves.h"
+#include "pieces.h"
+#include "training.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr char kStartPosition[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Time between progress reports.
+constexpr std::chrono::seconds kReportInterval(10);
+
+// Plays `plies` random legal moves from `board`. Returns nullopt if the
+// game ends before.
+std::optional<Board> RandomOpening(const Board& board, int plies, std::mt19937_64& random) {
+  Board position = board;
+  for (int ply = 0; ply < plies; ply++) {
+    std::vector<Move> moves;
+    MoveIterator iterator(position);
+    while (const std::optional<Move> move = iterator.Next(true, true, true)) {
+      moves.push_back(*move);
+    }
+    if (moves.empty()) {
+      return std::nullopt;
+    }
+    const Move move = moves[random() % moves.size()];
+    position.Move(move.from, move.to, move.promotion, move.castling);
+  }
+  return position;
+}
+
+bool IsQuiet(const Board& position, const Move& move) {
+  const Piece moving = position.Squares()[move.from.rank * 8 + move.from.file];
+  const bool capture = (
+    position.Squares()[move.to.rank * 8 + move.to.file] != Piece::EMPTY ||
+    ((moving & Piece::PAWN) && move.from.file != move.to.file));
+  const bool in_check = IsAttacked(
+    position, position.KingsPosition(position.WhiteToMove()), !position.WhiteToMove());
+  return !capture && move.promotion == Piece::EMPTY && !in_check;
+}
+
+// Returns the quiet positions of the game with their scores.
+std::vector<TrainingRecord> Label(const GameRecord& game) {
+  const int8_t result = (
+    game.result == GameResult::WHITE_WINS ? 1 : game.result == GameResult::BLACK_WINS ? -1 : 0);
+  std::vector<TrainingRecord> records;
+  Board position = game.start;
+  for (size_t i = 0; i < game.moves.size(); i++) {
+    const Move& move = game.moves[i];
+    const std::optional<int> score = game.scores[i];
+    if (score.has_value() && *score != std::numeric_limits<int>::max() &&
+        *score != std::numeric_limits<int>::min() && IsQuiet(position, move)) {
+      TrainingRecord record = {};
+      record.board = position.Pack();
+      record.score = static_cast<int16_t>(std::clamp(*score, -32000, 32000));
+      record.result = result;
+      records.push_back(record);
+    }
+    position.Move(move.from, move.to, move.promotion, move.castling);
+  }
+  return records;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: datagen <file> [--positions N] [--threads N] [--nodes N] [--hash MB] "
+              << "[--openings FILE] [--random-plies N] [--seed N] [--flush SECONDS]" << std::endl;
+    return 1;
+  }
+  const std::string path = argv[1];
+  uint64_t target = 1000000;
+  int threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  size_t hash_megabytes = 16;
+  int random_plies = 8;
+  uint64_t seed = 1;
+  int flush_seconds = 30;
+  std::string openings_path;
+  TimeControl control;
+  control.nodes = 5000;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--positions") == 0) {
+      target = std::stoull(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--threads") == 0) {
+      threads = std::max(std::atoi(argv[i + 1]), 1);
+    }
+    else if (strcmp(argv[i], "--nodes") == 0) {
+      control.nodes = std::max<uint64_t>(std::stoull(argv[i + 1]), 1);
+    }
+    else if (strcmp(argv[i], "--hash") == 0) {
+      hash_megabytes = std::max(std::atoi(argv[i + 1]), 1);
+    }
+    else if (strcmp(argv[i], "--openings") == 0) {
+      openings_path = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "--random-plies") == 0) {
+      random_plies = std::max(std::atoi(argv[i + 1]), 0);
+    }
+    else if (strcmp(argv[i], "--seed") == 0) {
+      seed = std::stoull(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "--flush") == 0) {
+      flush_seconds = std::max(std::atoi(argv[i + 1]), 1);
+    }
+  }
+
+  const char* bitbase_directory = getenv("CHESSENGINE_BITBASES");
+  LoadBitbases(bitbase_directory != nullptr ? bitbase_directory : "bitbases");
+
+  std::vector<Board> openings;
+  try {
+    if (!openings_path.empty()) {
+      LoadFENFile(openings_path, openings);
+    }
+  }
+  catch (const std::exception& error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+  if (openings.empty()) {
+    openings.push_back(Board::FromFEN(kStartPosition));
+  }
+
+  std::unique_ptr<TrainingWriter> writer;
+  try {
+    writer = std::make_unique<TrainingWriter>(path, std::chrono::seconds(flush_seconds));
+  }
+  catch (const std::exception& error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+  const uint64_t initial = writer->Count();
+  if (initial > 0) {
+    std::cout << "Continuing " << path << " with " << initial << " positions" << std::endl;
+  }
+
+  std::mutex mutex;
+  std::atomic<bool> done(writer->Count() >= target);
+  uint64_t games = 0;
+  const Clock::time_point start = Clock::now();
+  Clock::time_point last_report = start;
+  const auto report = [&]() {
+    const double hours = std::chrono::duration<double>(Clock::now() - start).count() / 3600;
+    const uint64_t positions = writer->Count() - initial;
+    printf("%llu positions, %llu games, %.0f positions/hour\n",
+           static_cast<unsigned long long>(writer->Count()),
+           static_cast<unsigned long long>(games), positions / std::max(hours, 1e-9));
+    fflush(stdout);
+  };
+
+  const auto worker = [&](int index) {
+    // Runs seeded by the records already written play new games.
+    std::mt19937_64 random(seed ^ (initial * 0x9E3779B97F4A7C15ull) ^ (index + 1));
+    SearchPlayer player(hash_megabytes, 1);
+    Adjudication adjudication;
+    while (!done.load()) {
+      const Board& opening = openings[random() % openings.size()];
+      const std::optional<Board> board = RandomOpening(opening, random_plies, random);
+      if (!board.has_value()) {
+        continue;
+      }
+      const std::vector<TrainingRecord> records = Label(
+        PlayGame(*board, player, player, control, adjudication));
+
+      std::lock_guard<std::mutex> lock(mutex);
+      for (const TrainingRecord& record : records) {
+        if (writer->Count() >= target) {
+          break;
+        }
+        writer->Write(record);
+      }
+      games++;
+      if (writer->Count() >= target) {
+        done.store(true);
+      }
+      if (Clock::now() - last_report >= kReportInterval) {
+        last_report = Clock::now();
+        report();
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back(worker, i);
+  }
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+  report();
+  try {
+    writer->Close();
+  }
+  catch (const std::exception& error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,436 @@
+// Generates the bitbases of bitbase.h by retrograde analysis.
+//
+// Usage: generate_bitbases [directory] [--threads N]
+//
+// All positions of a material set are first classified as illegal, drawn by
+// stalemate or by the capture of a piece, won by mate, or unknown. Passes
+// over the unknown positions then mark those won where the strong side has
+// a move to a won position, or the weak side only has moves to won
+// positions, until a pass finds no new wins. The remaining positions are
+// draws. Passes are split over threads; a position only ever changes from
+// unknown to won, so updates made by other threads during a pass merely
+// speed up convergence, and the result does not depend on their order.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitbase.h"
+#include "pieces.h"
+#include "thread_pool.h"
+
+namespace {
+
+enum State : uint8_t {
+  UNKNOWN = 0,
+  WIN = 1,
+  DRAW = 2,
+  ILLEGAL = 3,
+};
+
+// Positions handled by one task.
+constexpr uint64_t kBlockSize = 1 << 14;
+
+constexpr int kKingSteps[8][2] = {
+  {-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1},
+};
+constexpr int kKnightSteps[8][2] = {
+  {-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1},
+};
+constexpr int kBishopSteps[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+constexpr int kRookSteps[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+struct Position {
+  bool strong_to_move;
+  int strong_king;
+  int weak_king;
+  int pieces[2];
+};
+
+// A bitbase being generated.
+struct Table {
+  const BitbaseMaterial* material;
+  uint64_t size;
+  std::unique_ptr<std::atomic<uint8_t>[]> states;
+};
+
+Position Decode(const BitbaseMaterial& material, uint64_t index) {
+  Position position;
+  for (int i = material.num_pieces - 1; i >= 0; i--) {
+    position.pieces[i] = static_cast<int>(index % 64);
+    index /= 64;
+  }
+  position.weak_king = static_cast<int>(index % 64);
+  index /= 64;
+  position.strong_king = static_cast<int>(index % 64);
+  position.strong_to_move = index / 64 == 0;
+  return position;
+}
+
+uint64_t Encode(const BitbaseMaterial& material, const Position& position) {
+  return BitbaseIndex(material, position.strong_to_move, position.strong_king,
+                      position.weak_king, position.pieces);
+}
+
+// Returns the square `steps` away from `square`, or -1 if off the board.
+int Step(int square, const int* step) {
+  const int file = square % 8 + step[0];
+  const int rank = square / 8 + step[1];
+  return file < 0 || file > 7 || rank < 0 || rank > 7 ? -1 : rank * 8 + file;
+}
+
+bool Adjacent(int a, int b) {
+  return std::abs(a % 8 - b % 8) <= 1 && std::abs(a / 8 - b / 8) <= 1;
+}
+
+// Whether a slider on `from` moving by the given steps reaches `to` over
+// empty squares.
+bool SlidesTo(int from, int to, uint64_t occupied, const int (*steps)[2]) {
+  for (int i = 0; i < 4; i++) {
+    for (int square = Step(from, steps[i]); square >= 0; square = Step(square, steps[i])) {
+      if (square == to) {
+        return true;
+      }
+      if (occupied & (uint64_t{1} << square)) {
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+// Whether a strong piece of the given type on `from` attacks `to`.
+bool Attacks(Piece type, int from, int to, uint64_t occupied) {
+  switch (type) {
+    case Piece::PAWN:
+      return to / 8 == from / 8 + 1 && std::abs(to % 8 - from % 8) == 1;
+    case Piece::KNIGHT:
+      for (const auto& step : kKnightSteps) {
+        if (Step(from, step) == to) {
+          return true;
+        }
+      }
+      return false;
+    case Piece::BISHOP:
+      return SlidesTo(from, to, occupied, kBishopSteps);
+    case Piece::ROOK:
+      return SlidesTo(from, to, occupied, kRookSteps);
+    case Piece::QUEEN:
+      return SlidesTo(from, to, occupied, kBishopSteps) || SlidesTo(from, to, occupied, kRookSteps);
+    default:
+      return false;
+  }
+}
+
+// Whether the strong side attacks `square`, ignoring the piece `skip`,
+// e.g. one that is being captured.
+bool StrongAttacks(const BitbaseMaterial& material, const Position& position, int square,
+                   uint64_t occupied, int skip = -1) {
+  if (Adjacent(position.strong_king, square)) {
+    return true;
+  }
+  for (int i = 0; i < material.num_pieces; i++) {
+    if (i != skip && Attacks(material.pieces[i], position.pieces[i], square, occupied)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t Occupied(const BitbaseMaterial& material, const Position& position) {
+  uint64_t occupied = (uint64_t{1} << position.strong_king) | (uint64_t{1} << position.weak_king);
+  for (int i = 0; i < material.num_pieces; i++) {
+    occupied |= uint64_t{1} << position.pieces[i];
+  }
+  return occupied;
+}
+
+// Calls `visit` with each legal move of the weak king that captures
+// nothing, and returns false as soon as it does.
+template <typename Visit>
+bool ForEachWeakMove(const BitbaseMaterial& material, const Position& position, const Visit& visit) {
+  // Sliders attack through the square the king leaves.
+  const uint64_t occupied = Occupied(material, position) & ~(uint64_t{1} << position.weak_king);
+  for (const auto& step : kKingSteps) {
+    const int to = Step(position.weak_king, step);
+    if (to < 0 || (occupied & (uint64_t{1} << to)) ||
+        StrongAttacks(material, position, to, occupied)) {
+      continue;
+    }
+    Position next = position;
+    next.weak_king = to;
+    next.strong_to_move = true;
+    if (!visit(next)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Classifies a position before any pass.
+State Initial(const BitbaseMaterial& material, const Position& position) {
+  const uint64_t occupied = Occupied(material, position);
+  if (__builtin_popcountll(occupied) != 2 + material.num_pieces ||
+      Adjacent(position.strong_king, position.weak_king)) {
+    return ILLEGAL;
+  }
+  for (int i = 0; i < material.num_pieces; i++) {
+    const int rank = position.pieces[i] / 8;
+    if (material.pieces[i] == Piece::PAWN && (rank == 0 || rank == 7)) {
+      return ILLEGAL;
+    }
+  }
+  const bool in_check = StrongAttacks(material, position, position.weak_king, occupied);
+  if (position.strong_to_move) {
+    // The weak side can not have moved into check.
+    return in_check ? ILLEGAL : UNKNOWN;
+  }
+
+  // Capturing a piece leaves too little material to win.
+  for (int i = 0; i < material.num_pieces; i++) {
+    if (Adjacent(position.weak_king, position.pieces[i])) {
+      const uint64_t after = occupied & ~(uint64_t{1} << position.weak_king);
+      if (!StrongAttacks(material, position, position.pieces[i], after, i)) {
+        return DRAW;
+      }
+    }
+  }
+  bool has_move = false;
+  ForEachWeakMove(material, position, [&](const Position&) {
+    has_move = true;
+    return false;
+  });
+  if (!has_move) {
+    return in_check ? WIN : DRAW;
+  }
+  return UNKNOWN;
+}
+
+bool IsWin(const Table& table, const Position& position) {
+  return table.states[Encode(*table.material, position)].load(std::memory_order_relaxed) == WIN;
+}
+
+// Whether the strong side to move has a move to a won position. Promotions
+// are looked up in the tables of the new piece.
+bool StrongCanWin(const Table& table, const Position& position,
+                  const Table* queen_table, const Table* rook_table) {
+  const BitbaseMaterial& material = *table.material;
+  const uint64_t occupied = Occupied(material, position);
+  const auto empty = [&](int square) {
+    return square >= 0 && !(occupied & (uint64_t{1} << square));
+  };
+  Position next = position;
+  next.strong_to_move = false;
+
+  for (const auto& step : kKingSteps) {
+    const int to = Step(position.strong_king, step);
+    if (empty(to) && !Adjacent(to, position.weak_king)) {
+      next.strong_king = to;
+      if (IsWin(table, next)) {
+        return true;
+      }
+    }
+  }
+  next.strong_king = position.strong_king;
+
+  for (int i = 0; i < material.num_pieces; i++) {
+    const int from = position.pieces[i];
+    const auto moves_to = [&](int to) {
+      next.pieces[i] = to;
+      const bool win = IsWin(table, next);
+      next.pieces[i] = from;
+      return win;
+    };
+    switch (material.pieces[i]) {
+      case Piece::PAWN: {
+        const int to = from + 8;
+        if (!empty(to)) {
+          break;
+        }
+        if (to / 8 == 7) {
+          // Promotions to a knight or bishop can not win.
+          Position promoted = next;
+          promoted.pieces[0] = to;
+          if ((queen_table != nullptr && IsWin(*queen_table, promoted)) ||
+              (rook_table != nullptr && IsWin(*rook_table, promoted))) {
+            return true;
+          }
+          break;
+        }
+        if (moves_to(to) || (from / 8 == 1 && empty(to + 8) && moves_to(to + 8))) {
+          return true;
+        }
+        break;
+      }
+      case Piece::KNIGHT:
+        for (const auto& step : kKnightSteps) {
+          const int to = Step(from, step);
+          if (empty(to) && moves_to(to)) {
+            return true;
+          }
+        }
+        break;
+      default: {
+        const Piece type = material.pieces[i];
+        for (int direction = 0; direction < 8; direction++) {
+          const bool diagonal = direction < 4;
+          if ((diagonal && type == Piece::ROOK) || (!diagonal && type == Piece::BISHOP)) {
+            continue;
+          }
+          const int* step = diagonal ? kBishopSteps[direction] : kRookSteps[direction - 4];
+          for (int to = Step(from, step); empty(to); to = Step(to, step)) {
+            if (moves_to(to)) {
+              return true;
+            }
+          }
+        }
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+// Runs `work` on the indices of the table, split over the pool, and
+// returns the sum of its results.
+template <typename Work>
+uint64_t ParallelSum(ThreadPool& pool, uint64_t size, const Work& work) {
+  std::atomic<uint64_t> sum{0};
+  for (uint64_t start = 0; start < size; start += kBlockSize) {
+    pool.Submit([&, start]() {
+      uint64_t count = 0;
+      const uint64_t end = std::min(start + kBlockSize, size);
+      for (uint64_t index = start; index < end; index++) {
+        count += work(index);
+      }
+      sum.fetch_add(count, std::memory_order_relaxed);
+    });
+  }
+  pool.Wait();
+  return sum.load();
+}
+
+void Generate(Table& table, ThreadPool& pool, const Table* queen_table, const Table* rook_table) {
+  const BitbaseMaterial& material = *table.material;
+  ParallelSum(pool, table.size, [&](uint64_t index) {
+    table.states[index].store(Initial(material, Decode(material, index)), std::memory_order_relaxed);
+    return 0;
+  });
+
+  int passes = 0;
+  uint64_t found;
+  do {
+    found = ParallelSum(pool, table.size, [&](uint64_t index) -> uint64_t {
+      if (table.states[index].load(std::memory_order_relaxed) != UNKNOWN) {
+        return 0;
+      }
+      const Position position = Decode(material, index);
+      bool win;
+      if (position.strong_to_move) {
+        win = StrongCanWin(table, position, queen_table, rook_table);
+      }
+      else {
+        win = ForEachWeakMove(material, position, [&](const Position& next) {
+          return IsWin(table, next);
+        });
+      }
+      if (!win) {
+        return 0;
+      }
+      table.states[index].store(WIN, std::memory_order_relaxed);
+      return 1;
+    });
+    passes++;
+  } while (found > 0);
+
+  uint64_t counts[4] = {0, 0, 0, 0};
+  for (uint64_t index = 0; index < table.size; index++) {
+    counts[table.states[index].load(std::memory_order_relaxed)]++;
+  }
+  std::cout << material.name << ": " << passes << " passes, " << counts[WIN] << " won, "
+            << counts[UNKNOWN] + counts[DRAW] << " drawn, " << counts[ILLEGAL] << " illegal"
+            << std::endl;
+}
+
+void Write(const Table& table, const std::string& path) {
+  std::vector<uint8_t> bits(table.size / 8, 0);
+  for (uint64_t index = 0; index < table.size; index++) {
+    if (table.states[index].load(std::memory_order_relaxed) == WIN) {
+      bits[index / 8] |= 1 << (index % 8);
+    }
+  }
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("cannot create " + path + ": " + strerror(errno));
+  }
+  fwrite(kBitbaseMagic, sizeof(kBitbaseMagic), 1, file);
+  fwrite(bits.data(), 1, bits.size(), file);
+  const bool failed = ferror(file) != 0;
+  if (fclose(file) != 0 || failed) {
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string directory = "bitbases";
+  int threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = std::max(std::atoi(argv[++i]), 1);
+    }
+    else {
+      directory = argv[i];
+    }
+  }
+
+  ThreadPool pool(threads);
+  std::vector<Table> tables(kNumBitbases);
+  const Table* queen_table = nullptr;
+  const Table* rook_table = nullptr;
+  // Sets with pawns promote into the sets of the other pieces, so those
+  // come first.
+  for (const bool pawns : {false, true}) {
+    for (size_t i = 0; i < kNumBitbases; i++) {
+      const BitbaseMaterial& material = kBitbaseMaterials[i];
+      if ((material.pieces[0] == Piece::PAWN) != pawns) {
+        continue;
+      }
+      const auto start = std::chrono::steady_clock::now();
+      Table& table = tables[i];
+      table.material = &material;
+      table.size = BitbasePositions(material);
+      table.states.reset(new std::atomic<uint8_t>[table.size]);
+      Generate(table, pool, queen_table, rook_table);
+      if (material.num_pieces == 1 && material.pieces[0] == Piece::QUEEN) {
+        queen_table = &table;
+      }
+      if (material.num_pieces == 1 && material.pieces[0] == Piece::ROOK) {
+        rook_table = &table;
+      }
+
+      const std::string path = directory + "/" + material.name + ".bb";
+      try {
+        Write(table, path);
+      }
+      catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+      }
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      std::cout << "Wrote " << path << " in " << elapsed.count() << " s" << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,317 @@
+// Plays games between two engines, e.g. to test a change against the
+// version before it.
+//
+// Usage: match --first ENGINE --second ENGINE [--games N] [--concurrency N]
+//              [--openings FILE] [--seed N] [--tc SECONDS[+INCREMENT]]
+//              [--depth N] [--nodes N] [--sprt ELO0,ELO1] [--alpha A]
+//              [--beta B] [--resign SCORE,MOVES] [--draw PLY,SCORE,MOVES]
+//              [--max-plies N]
+//
+// ENGINE is "internal" for a search run in this process, or the command
+// line of a UCI engine, e.g. "./engine uci". Words of the form NAME=VALUE
+// set UCI options, or hash=MB and threads=N of an internal search.
+//
+// Openings are FEN lines, shuffled with the seed, and each is played twice
+// with colours swapped. Results are from the point of view of the first
+// engine. With --sprt, the match stops as soon as the test accepts either
+// hypothesis, and games still running are finished but not counted.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bitbase.h"
+#include "board.h"
+#include "fen.h"
+#include "match.h"
+
+namespace {
+
+constexpr char kStartPosition[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct EngineSpec {
+  std::vector<std::string> command;
+  std::vector<std::pair<std::string, std::string>> options;
+};
+
+EngineSpec ParseEngineSpec(const std::string& text) {
+  EngineSpec spec;
+  std::istringstream words(text);
+  std::string word;
+  while (words >> word) {
+    const size_t equals = word.find('=');
+    if (equals != std::string::npos) {
+      spec.options.emplace_back(word.substr(0, equals), word.substr(equals + 1));
+    }
+    else {
+      spec.command.push_back(word);
+    }
+  }
+  return spec;
+}
+
+std::unique_ptr<Player> CreatePlayer(const EngineSpec& spec) {
+  if (spec.command.size() == 1 && spec.command[0] == "internal") {
+    size_t hash_megabytes = 16;
+    int threads = 1;
+    for (const auto& [name, value] : spec.options) {
+      if (name == "hash") {
+        hash_megabytes = std::stoul(value);
+      }
+      else if (name == "threads") {
+        threads = std::max(std::stoi(value), 1);
+      }
+    }
+    return std::make_unique<SearchPlayer>(hash_megabytes, threads);
+  }
+  return std::make_unique<UciPlayer>(spec.command, spec.options);
+}
+
+// Splits "a,b,c" into numbers.
+std::vector<double> ParseNumbers(const std::string& text) {
+  std::vector<double> numbers;
+  std::istringstream items(text);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    numbers.push_back(std::atof(item.c_str()));
+  }
+  return numbers;
+}
+
+// Results of the first engine.
+struct Score {
+  uint64_t wins = 0;
+  uint64_t draws = 0;
+  uint64_t losses = 0;
+
+  uint64_t Games() const {
+    return this->wins + this->draws + this->losses;
+  }
+};
+
+void PrintScore(const Score& score, const std::optional<Sprt>& sprt) {
+  const double games = score.Games();
+  const double mean = (score.wins + score.draws / 2.0) / games;
+  const double variance = (
+    score.wins * (1 - mean) * (1 - mean) + score.draws * (0.5 - mean) * (0.5 - mean) +
+    score.losses * mean * mean) / games;
+  // 95% confidence interval of the mean score, in Elo.
+  const double margin = 1.96 * std::sqrt(variance / games);
+  const auto elo = [](double value) {
+    return EloFromScore(std::clamp(value, 1e-6, 1 - 1e-6));
+  };
+  printf("Games %llu: +%llu =%llu -%llu, score %.1f%%, Elo %.1f +/- %.1f",
+         static_cast<unsigned long long>(score.Games()),
+         static_cast<unsigned long long>(score.wins),
+         static_cast<unsigned long long>(score.draws),
+         static_cast<unsigned long long>(score.losses),
+         100 * mean, elo(mean), (elo(mean + margin) - elo(mean - margin)) / 2);
+  if (sprt.has_value()) {
+    printf(", LLR %.2f (%.2f, %.2f)", sprt->LogLikelihoodRatio(score.wins, score.draws, score.losses),
+           sprt->LowerBound(), sprt->UpperBound());
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // An engine exiting early must not end the match.
+  signal(SIGPIPE, SIG_IGN);
+
+  std::string first;
+  std::string second;
+  std::string openings_path;
+  uint64_t games = 1000;
+  int concurrency = 1;
+  uint64_t seed = 1;
+  TimeControl control;
+  Adjudication adjudication;
+  std::optional<Sprt> sprt;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string option = argv[i];
+    const std::string value = argv[i + 1];
+    if (option == "--first") {
+      first = value;
+    }
+    else if (option == "--second") {
+      second = value;
+    }
+    else if (option == "--games") {
+      games = std::stoull(value);
+    }
+    else if (option == "--concurrency") {
+      concurrency = std::max(std::stoi(value), 1);
+    }
+    else if (option == "--openings") {
+      openings_path = value;
+    }
+    else if (option == "--seed") {
+      seed = std::stoull(value);
+    }
+    else if (option == "--tc") {
+      const size_t plus = value.find('+');
+      control.base = static_cast<int64_t>(std::atof(value.c_str()) * 1000);
+      if (plus != std::string::npos) {
+        control.increment = static_cast<int64_t>(std::atof(value.c_str() + plus + 1) * 1000);
+      }
+    }
+    else if (option == "--depth") {
+      control.depth = std::stoi(value);
+    }
+    else if (option == "--nodes") {
+      control.nodes = std::stoull(value);
+    }
+    else if (option == "--sprt") {
+      const std::vector<double> elos = ParseNumbers(value);
+      sprt = sprt.value_or(Sprt());
+      sprt->elo0 = elos.size() > 0 ? elos[0] : 0;
+      sprt->elo1 = elos.size() > 1 ? elos[1] : 5;
+    }
+    else if (option == "--alpha" || option == "--beta") {
+      sprt = sprt.value_or(Sprt());
+      (option == "--alpha" ? sprt->alpha : sprt->beta) = std::atof(value.c_str());
+    }
+    else if (option == "--resign") {
+      const std::vector<double> values = ParseNumbers(value);
+      adjudication.resign_score = values.size() > 0 ? values[0] : 0;
+      adjudication.resign_moves = values.size() > 1 ? values[1] : 3;
+    }
+    else if (option == "--draw") {
+      const std::vector<double> values = ParseNumbers(value);
+      adjudication.draw_ply = values.size() > 0 ? values[0] : 80;
+      adjudication.draw_score = values.size() > 1 ? values[1] : 10;
+      adjudication.draw_moves = values.size() > 2 ? values[2] : 0;
+    }
+    else if (option == "--max-plies") {
+      adjudication.max_plies = std::stoi(value);
+    }
+    else {
+      std::cerr << "Unknown option " << option << std::endl;
+      return 1;
+    }
+  }
+  if (first.empty() || second.empty()) {
+    std::cerr << "Usage: match --first ENGINE --second ENGINE [options]" << std::endl;
+    return 1;
+  }
+  if (control.base <= 0 && control.depth <= 0 && control.nodes == 0) {
+    std::cerr << "Set a time control, or a depth or node limit" << std::endl;
+    return 1;
+  }
+
+  std::vector<Board> openings;
+  if (!openings_path.empty()) {
+    try {
+      const size_t malformed = LoadFENFile(openings_path, openings);
+      if (malformed > 0) {
+        std::cerr << "Skipped " << malformed << " malformed openings" << std::endl;
+      }
+    }
+    catch (const std::exception& error) {
+      std::cerr << error.what() << std::endl;
+      return 1;
+    }
+    std::mt19937_64 random(seed);
+    std::shuffle(openings.begin(), openings.end(), random);
+  }
+  if (openings.empty()) {
+    openings.push_back(Board::FromFEN(kStartPosition));
+  }
+
+  // Used by internal searches and for adjudication, as by the engine.
+  const char* bitbase_directory = getenv("CHESSENGINE_BITBASES");
+  LoadBitbases(bitbase_directory != nullptr ? bitbase_directory : "bitbases");
+
+  const EngineSpec specs[2] = {ParseEngineSpec(first), ParseEngineSpec(second)};
+  std::mutex mutex;
+  Score score;
+  std::atomic<uint64_t> next_game(0);
+  std::atomic<bool> done(false);
+  bool failed = false;
+
+  const auto worker = [&]() {
+    std::unique_ptr<Player> players[2];
+    try {
+      players[0] = CreatePlayer(specs[0]);
+      players[1] = CreatePlayer(specs[1]);
+    }
+    catch (const std::exception& error) {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::cerr << error.what() << std::endl;
+      failed = true;
+      done.store(true);
+      return;
+    }
+    while (!done.load()) {
+      const uint64_t game = next_game++;
+      if (game >= games) {
+        break;
+      }
+      // Pairs of games share their opening, with the first engine playing
+      // white in the first game of each pair.
+      const Board& opening = openings[(game / 2) % openings.size()];
+      const bool first_white = game % 2 == 0;
+      const GameRecord record = PlayGame(
+        opening, first_white ? *players[0] : *players[1], first_white ? *players[1] : *players[0],
+        control, adjudication);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (done.load()) {
+        break;
+      }
+      if (record.result == GameResult::DRAW) {
+        score.draws++;
+      }
+      else if ((record.result == GameResult::WHITE_WINS) == first_white) {
+        score.wins++;
+      }
+      else {
+        score.losses++;
+      }
+      printf("Game %llu: %s %s (%s)\n", static_cast<unsigned long long>(game + 1),
+             first_white ? "first-second" : "second-first", GameResultString(record.result),
+             record.termination.c_str());
+      PrintScore(score, sprt);
+      if (sprt.has_value()) {
+        const double llr = sprt->LogLikelihoodRatio(score.wins, score.draws, score.losses);
+        if (llr >= sprt->UpperBound() || llr <= sprt->LowerBound()) {
+          printf("SPRT: H%d accepted\n", llr >= sprt->UpperBound() ? 1 : 0);
+          done.store(true);
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < concurrency; i++) {
+    threads.emplace_back(worker);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  if (failed) {
+    return 1;
+  }
+  if (score.Games() > 0) {
+    printf("Final: ");
+    PrintScore(score, sprt);
+  }
+  return 0;
+}
@@ -0,0 +1,246 @@
+// Summarises a search trace written by `engine trace`.
+//
+// Usage: trace_summary <trace> [--search N] [--top N] [--plies N]
+//                      [--folded FILE] [--fold-depth N]
+//
+// Lists the searches in the trace, one per iteration, with their node
+// counts, and counts the reasons nodes returned for. For one search, the
+// last one unless --search is given, shows the subtree size and score of
+// every root move, and the lines of --plies moves with the most nodes
+// below them.
+//
+// With --folded, also writes the trees in the folded stack format of
+// flamegraph.pl, a frame per move, where nodes deeper than --fold-depth
+// are counted to their ancestor at that depth.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "moves.h"
+#include "trace.h"
+
+namespace {
+
+// Records of one iteration, from the first record up to the root.
+struct TracedSearch {
+  size_t begin;
+  size_t root;
+};
+
+struct Line {
+  std::vector<uint32_t> moves;
+  uint64_t nodes;
+  int score;
+};
+
+std::string ScoreToString(int score) {
+  if (score == std::numeric_limits<int>::max()) {
+    return "+mate";
+  }
+  if (score == std::numeric_limits<int>::min()) {
+    return "-mate";
+  }
+  return std::to_string(score);
+}
+
+std::string MovesToString(const std::vector<uint32_t>& moves, char separator) {
+  std::string text;
+  for (const uint32_t move : moves) {
+    text += (text.empty() ? "" : std::string(1, separator)) + MoveToString(UnpackMove(move));
+  }
+  return text;
+}
+
+// Returns the number of nodes in the subtree of every record. Records are
+// in post-order, so the nodes below a record are counted by ply before it
+// is reached.
+std::vector<uint64_t> SubtreeSizes(const TraceReader& trace, std::vector<TracedSearch>& searches) {
+  std::vector<uint64_t> sizes(trace.Count());
+  std::vector<uint64_t> pending;
+  size_t begin = 0;
+  for (size_t i = 0; i < trace.Count(); i++) {
+    const size_t ply = trace[i].ply;
+    if (pending.size() < ply + 2) {
+      pending.resize(ply + 2, 0);
+    }
+    sizes[i] = 1 + pending[ply + 1];
+    pending[ply + 1] = 0;
+    if (ply == 0) {
+      searches.push_back({begin, i});
+      begin = i + 1;
+      std::fill(pending.begin(), pending.end(), 0);
+    }
+    else {
+      pending[ply] += sizes[i];
+    }
+  }
+  return sizes;
+}
+
+// Calls `visit` with every record of the search, from the root down, and
+// the moves leading to it. The parent of a record is the closest record
+// after it one ply up, so the tree is walked from the end.
+template <typename Visitor>
+void WalkTree(const TraceReader& trace, const TracedSearch& search, const Visitor& visit) {
+  std::vector<uint32_t> line;
+  for (size_t i = search.root + 1; i-- > search.begin;) {
+    const TraceRecord& record = trace[i];
+    if (record.ply == 0) {
+      line.clear();
+    }
+    else if (record.ply <= line.size() + 1) {
+      line.resize(record.ply - 1);
+      line.push_back(record.move);
+    }
+    else {
+      // A record without a parent, from a damaged trace.
+      continue;
+    }
+    visit(i, line);
+  }
+}
+
+void PrintSearch(const TraceReader& trace, const std::vector<uint64_t>& sizes,
+                 const TracedSearch& search, size_t top, size_t plies) {
+  std::vector<Line> root_moves;
+  std::vector<Line> lines;
+  WalkTree(trace, search, [&](size_t i, const std::vector<uint32_t>& line) {
+    const TraceRecord& record = trace[i];
+    if (record.ply == 1) {
+      root_moves.push_back({line, sizes[i], record.score});
+    }
+    if (record.ply == plies) {
+      lines.push_back({line, sizes[i], record.score});
+    }
+  });
+  const auto by_nodes = [](const Line& lhs, const Line& rhs) {
+    return lhs.nodes > rhs.nodes;
+  };
+  std::sort(root_moves.begin(), root_moves.end(), by_nodes);
+  std::sort(lines.begin(), lines.end(), by_nodes);
+
+  const uint64_t total = sizes[search.root];
+  std::cout << std::endl << std::left << std::setw(10) << "move" << std::right
+            << std::setw(12) << "nodes" << std::setw(8) << "%" << std::setw(10) << "score"
+            << std::endl;
+  for (const Line& move : root_moves) {
+    std::cout << std::left << std::setw(10) << MovesToString(move.moves, ' ') << std::right
+              << std::setw(12) << move.nodes << std::setw(8) << std::fixed
+              << std::setprecision(1) << 100.0 * move.nodes / total
+              << std::setw(10) << ScoreToString(move.score) << std::endl;
+  }
+  std::cout << std::endl << "Lines of " << plies << " plies with the most nodes:" << std::endl;
+  for (size_t i = 0; i < lines.size() && i < top; i++) {
+    std::cout << std::setw(12) << lines[i].nodes << "  "
+              << MovesToString(lines[i].moves, ' ')
+              << " (" << ScoreToString(lines[i].score) << ")" << std::endl;
+  }
+}
+
+void WriteFolded(const TraceReader& trace, const std::vector<uint64_t>& sizes,
+                 const std::vector<TracedSearch>& searches, size_t fold_depth,
+                 std::ostream& output) {
+  for (size_t s = 0; s < searches.size(); s++) {
+    const std::string root = (
+      "search " + std::to_string(s + 1) + " depth " +
+      std::to_string(trace[searches[s].root].depth));
+    WalkTree(trace, searches[s], [&](size_t i, const std::vector<uint32_t>& line) {
+      if (line.size() > fold_depth) {
+        return;
+      }
+      const uint64_t nodes = line.size() == fold_depth ? sizes[i] : 1;
+      output << root << (line.empty() ? "" : ";") << MovesToString(line, ';') << ' '
+             << nodes << '\n';
+    });
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: trace_summary <trace> [--search N] [--top N] [--plies N] "
+              << "[--folded FILE] [--fold-depth N]" << std::endl;
+    return 1;
+  }
+  size_t selected = 0;
+  size_t top = 10;
+  size_t plies = 3;
+  size_t fold_depth = 8;
+  std::string folded;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--search") == 0) {
+      selected = std::max(std::atoi(argv[i + 1]), 1);
+    }
+    else if (strcmp(argv[i], "--top") == 0) {
+      top = std::max(std::atoi(argv[i + 1]), 0);
+    }
+    else if (strcmp(argv[i], "--plies") == 0) {
+      plies = std::max(std::atoi(argv[i + 1]), 1);
+    }
+    else if (strcmp(argv[i], "--folded") == 0) {
+      folded = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "--fold-depth") == 0) {
+      fold_depth = std::max(std::atoi(argv[i + 1]), 0);
+    }
+  }
+
+  try {
+    const TraceReader trace(argv[1]);
+    std::vector<TracedSearch> searches;
+    const std::vector<uint64_t> sizes = SubtreeSizes(trace, searches);
+    if (searches.empty()) {
+      std::cerr << "No complete search in " << argv[1] << std::endl;
+      return 1;
+    }
+
+    std::cout << std::setw(8) << "search" << std::setw(8) << "depth" << std::setw(12) << "nodes"
+              << std::setw(10) << "score" << std::setw(10) << "result" << std::endl;
+    for (size_t s = 0; s < searches.size(); s++) {
+      const TraceRecord& root = trace[searches[s].root];
+      std::cout << std::setw(8) << s + 1 << std::setw(8) << static_cast<int>(root.depth)
+                << std::setw(12) << sizes[searches[s].root]
+                << std::setw(10) << ScoreToString(root.score)
+                << std::setw(10) << TraceReasonName(root.reason) << std::endl;
+    }
+
+    std::map<std::string, uint64_t> reasons;
+    for (size_t i = 0; i < trace.Count(); i++) {
+      reasons[TraceReasonName(trace[i].reason)]++;
+    }
+    std::cout << std::endl << "Nodes by reason:" << std::endl;
+    for (const auto& [reason, count] : reasons) {
+      std::cout << std::setw(12) << count << "  " << reason << std::endl;
+    }
+
+    if (selected == 0 || selected > searches.size()) {
+      selected = searches.size();
+    }
+    std::cout << std::endl << "Search " << selected << ":";
+    PrintSearch(trace, sizes, searches[selected - 1], top, plies);
+
+    if (!folded.empty()) {
+      std::ofstream output(folded);
+      WriteFolded(trace, sizes, searches, fold_depth, output);
+      if (!output) {
+        std::cerr << "Cannot write " << folded << std::endl;
+        return 1;
+      }
+    }
+  }
+  catch (const std::exception& error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
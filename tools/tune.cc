@@ -0,0 +1,365 @@
+// Fits the evaluation parameters to labelled positions, Texel style.
+//
+// Usage: tune <training file>... [--output FILE] [--epochs N] [--rate R]
+//             [--lambda L] [--threads N]
+//
+// The evaluation is linear in its parameters, so every position is stored
+// as its sparse feature vector: the coefficient of each parameter, e.g.
+// the number of white minus black knights. The error is the mean squared
+// difference between the game result and a sigmoid of the evaluation,
+// whose scale is fitted first. With --lambda below 1, the search score of
+// the position is blended into the target. The parameters are then fitted
+// with Adam on the full-batch gradient, computed in parallel, and written
+// as a header to --output, by default include/evaluation_params.h.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "evaluation.h"
+#include "evaluation_params.h"
+#include "pieces.h"
+#include "thread_pool.h"
+#include "training.h"
+
+namespace {
+
+struct Parameter {
+  const char* name;
+  Piece piece;
+  int initial;
+};
+
+// Parameters of evaluation.cc, in the order written to the header.
+constexpr Parameter kParameters[] = {
+  {"kPawn", Piece::PAWN, kPawn},
+  {"kKnight", Piece::KNIGHT, kKnight},
+  {"kBishop", Piece::BISHOP, kBishop},
+  {"kRook", Piece::ROOK, kRook},
+  {"kQueen", Piece::QUEEN, kQueen},
+};
+constexpr size_t kNumParameters = sizeof(kParameters) / sizeof(kParameters[0]);
+
+struct Feature {
+  uint16_t parameter;
+  int16_t coefficient;
+};
+
+// Positions as feature vectors, with the target of the prediction.
+struct TuningSet {
+  // Features of position i are features[offsets[i]] to features[offsets[i + 1]].
+  std::vector<uint32_t> offsets = {0};
+  std::vector<Feature> features;
+  std::vector<float> targets;
+
+  size_t Size() const {
+    return this->targets.size();
+  }
+
+  void Append(const TuningSet& other) {
+    const uint32_t base = this->features.size();
+    for (size_t i = 1; i < other.offsets.size(); i++) {
+      this->offsets.push_back(base + other.offsets[i]);
+    }
+    this->features.insert(this->features.end(), other.features.begin(), other.features.end());
+    this->targets.insert(this->targets.end(), other.targets.begin(), other.targets.end());
+  }
+};
+
+// Appends the coefficients of the parameters in the evaluation of `board`.
+// Must stay in sync with evaluation.cc, which is checked when loading.
+void ExtractFeatures(const Board& board, std::vector<Feature>& features) {
+  int coefficients[kNumParameters] = {};
+  for (int square = 0; square < 64; square++) {
+    const Piece piece = board.Squares()[square];
+    for (size_t i = 0; i < kNumParameters; i++) {
+      if (piece & kParameters[i].piece) {
+        coefficients[i] += (piece & Piece::IS_WHITE) ? 1 : -1;
+      }
+    }
+  }
+  for (size_t i = 0; i < kNumParameters; i++) {
+    if (coefficients[i] != 0) {
+      features.push_back({static_cast<uint16_t>(i), static_cast<int16_t>(coefficients[i])});
+    }
+  }
+}
+
+double Sigmoid(double scale, double evaluation) {
+  return 1 / (1 + std::pow(10.0, -scale * evaluation / 400));
+}
+
+// Runs `task(begin, end, thread)` over slices of `size` items on the pool.
+template <typename Task>
+void ParallelFor(ThreadPool& pool, size_t size, const Task& task) {
+  const size_t threads = pool.Size();
+  for (size_t thread = 0; thread < threads; thread++) {
+    pool.Submit([&task, size, threads, thread]() {
+      task(size * thread / threads, size * (thread + 1) / threads, thread);
+    });
+  }
+  pool.Wait();
+}
+
+class Tuner {
+ public:
+  Tuner(const TuningSet& set, ThreadPool& pool) : set(set), pool(pool) {}
+
+  double Evaluate(const std::vector<double>& parameters, size_t position) const {
+    double evaluation = 0;
+    for (uint32_t i = this->set.offsets[position]; i < this->set.offsets[position + 1]; i++) {
+      const Feature& feature = this->set.features[i];
+      evaluation += parameters[feature.parameter] * feature.coefficient;
+    }
+    return evaluation;
+  }
+
+  double Error(const std::vector<double>& parameters, double scale) {
+    std::vector<double> errors(this->pool.Size(), 0);
+    ParallelFor(this->pool, this->set.Size(), [&](size_t begin, size_t end, size_t thread) {
+      double error = 0;
+      for (size_t i = begin; i < end; i++) {
+        const double difference = (
+          this->set.targets[i] - Sigmoid(scale, this->Evaluate(parameters, i)));
+        error += difference * difference;
+      }
+      errors[thread] = error;
+    });
+    double total = 0;
+    for (const double error : errors) {
+      total += error;
+    }
+    return total / this->set.Size();
+  }
+
+  // Returns the gradient of the error by the parameters.
+  std::vector<double> Gradient(const std::vector<double>& parameters, double scale) {
+    std::vector<std::vector<double>> gradients(
+      this->pool.Size(), std::vector<double>(parameters.size(), 0));
+    ParallelFor(this->pool, this->set.Size(), [&](size_t begin, size_t end, size_t thread) {
+      std::vector<double>& gradient = gradients[thread];
+      for (size_t i = begin; i < end; i++) {
+        const double prediction = Sigmoid(scale, this->Evaluate(parameters, i));
+        const double slope = (
+          -2 * (this->set.targets[i] - prediction) * prediction * (1 - prediction));
+        for (uint32_t j = this->set.offsets[i]; j < this->set.offsets[i + 1]; j++) {
+          const Feature& feature = this->set.features[j];
+          gradient[feature.parameter] += slope * feature.coefficient;
+        }
+      }
+    });
+    // The constant factor of the sigmoid's derivative, and the mean.
+    const double factor = scale * std::log(10.0) / 400 / this->set.Size();
+    std::vector<double> total(parameters.size(), 0);
+    for (const std::vector<double>& gradient : gradients) {
+      for (size_t j = 0; j < total.size(); j++) {
+        total[j] += gradient[j] * factor;
+      }
+    }
+    return total;
+  }
+
+  // Finds the scale of the sigmoid that best fits the parameters, by
+  // ternary search, as the error is unimodal in it.
+  double FitScale(const std::vector<double>& parameters) {
+    double low = 0.01;
+    double high = 10;
+    for (int i = 0; i < 50; i++) {
+      const double a = low + (high - low) / 3;
+      const double b = high - (high - low) / 3;
+      if (this->Error(parameters, a) < this->Error(parameters, b)) {
+        high = b;
+      }
+      else {
+        low = a;
+      }
+    }
+    return (low + high) / 2;
+  }
+
+ private:
+  const TuningSet& set;
+  ThreadPool& pool;
+};
+
+// Loads the records of a training file in parallel. Returns false if the
+// features disagree with the evaluation.
+bool Load(const TrainingReader& reader, double lambda, double scale, ThreadPool& pool,
+          TuningSet& set) {
+  std::vector<TuningSet> parts(pool.Size());
+  std::vector<size_t> mismatches(pool.Size(), 0);
+  ParallelFor(pool, reader.Count(), [&](size_t begin, size_t end, size_t thread) {
+    TuningSet& part = parts[thread];
+    Board board;
+    for (size_t i = begin; i < end; i++) {
+      const TrainingRecord& record = reader[i];
+      if (!Board::Unpack(record.board, board)) {
+        continue;
+      }
+      const size_t first = part.features.size();
+      ExtractFeatures(board, part.features);
+      int evaluation = 0;
+      for (size_t j = first; j < part.features.size(); j++) {
+        evaluation += kParameters[part.features[j].parameter].initial * part.features[j].coefficient;
+      }
+      if (evaluation != CountPieces(&board)) {
+        mismatches[thread]++;
+      }
+      part.offsets.push_back(part.features.size());
+      const double result = (record.result + 1) / 2.0;
+      part.targets.push_back(lambda * result + (1 - lambda) * Sigmoid(scale, record.score));
+    }
+  });
+  for (const TuningSet& part : parts) {
+    set.Append(part);
+  }
+  for (const size_t count : mismatches) {
+    if (count > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WriteHeader(const std::string& path, const std::vector<double>& parameters,
+                 size_t positions, double error) {
+  std::ofstream output(path);
+  output << "// Evaluation parameters, generated by `tune` from " << positions << " positions\n"
+         << "// with a mean squared error of " << error << ". Edit by hand only to\n"
+         << "// try other starting values.\n"
+         << "\n"
+         << "#ifndef CHESSENGINE_EVALUATION_PARAMS_H\n"
+         << "#define CHESSENGINE_EVALUATION_PARAMS_H\n"
+         << "\n";
+  for (size_t i = 0; i < kNumParameters; i++) {
+    output << "constexpr int " << kParameters[i].name << " = "
+           << static_cast<int>(std::lround(parameters[i])) << ";\n";
+  }
+  output << "\n#endif\n";
+  return static_cast<bool>(output);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> inputs;
+  std::string output = "include/evaluation_params.h";
+  int epochs = 1000;
+  double rate = 1;
+  double lambda = 1;
+  int threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--", 2) != 0) {
+      inputs.push_back(argv[i]);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      break;
+    }
+    if (strcmp(argv[i], "--output") == 0) {
+      output = argv[++i];
+    }
+    else if (strcmp(argv[i], "--epochs") == 0) {
+      epochs = std::max(std::atoi(argv[++i]), 0);
+    }
+    else if (strcmp(argv[i], "--rate") == 0) {
+      rate = std::atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--lambda") == 0) {
+      lambda = std::clamp(std::atof(argv[++i]), 0.0, 1.0);
+    }
+    else if (strcmp(argv[i], "--threads") == 0) {
+      threads = std::max(std::atoi(argv[++i]), 1);
+    }
+    else {
+      i++;
+    }
+  }
+  if (inputs.empty()) {
+    std::cerr << "Usage: tune <training file>... [--output FILE] [--epochs N] [--rate R] "
+              << "[--lambda L] [--threads N]" << std::endl;
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  ThreadPool pool(threads);
+  std::vector<double> parameters;
+  for (const Parameter& parameter : kParameters) {
+    parameters.push_back(parameter.initial);
+  }
+
+  // Search scores are blended in on the scale of the game results, which
+  // is only known once loaded, so targets are first loaded without them.
+  TuningSet set;
+  try {
+    for (const std::string& input : inputs) {
+      const TrainingReader reader(input);
+      if (!Load(reader, 1, 1, pool, set)) {
+        std::cerr << "The features of tools/tune.cc disagree with src/evaluation.cc" << std::endl;
+        return 1;
+      }
+    }
+  }
+  catch (const std::exception& error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+  if (set.Size() == 0) {
+    std::cerr << "No positions" << std::endl;
+    return 1;
+  }
+  Tuner tuner(set, pool);
+  const double scale = tuner.FitScale(parameters);
+  if (lambda < 1) {
+    set = TuningSet();
+    for (const std::string& input : inputs) {
+      Load(TrainingReader(input), lambda, scale, pool, set);
+    }
+  }
+  printf("%zu positions, %zu features, scale %.3f, error %.6f\n", set.Size(),
+         set.features.size(), scale, tuner.Error(parameters, scale));
+
+  // Adam, with the usual decay rates.
+  constexpr double kBeta1 = 0.9;
+  constexpr double kBeta2 = 0.999;
+  constexpr double kEpsilon = 1e-8;
+  std::vector<double> momentum(kNumParameters, 0);
+  std::vector<double> velocity(kNumParameters, 0);
+  for (int epoch = 1; epoch <= epochs; epoch++) {
+    const std::vector<double> gradient = tuner.Gradient(parameters, scale);
+    for (size_t j = 0; j < kNumParameters; j++) {
+      momentum[j] = kBeta1 * momentum[j] + (1 - kBeta1) * gradient[j];
+      velocity[j] = kBeta2 * velocity[j] + (1 - kBeta2) * gradient[j] * gradient[j];
+      const double corrected_momentum = momentum[j] / (1 - std::pow(kBeta1, epoch));
+      const double corrected_velocity = velocity[j] / (1 - std::pow(kBeta2, epoch));
+      parameters[j] -= rate * corrected_momentum / (std::sqrt(corrected_velocity) + kEpsilon);
+    }
+    if (epoch % 100 == 0 || epoch == epochs) {
+      printf("Epoch %d: error %.6f\n", epoch, tuner.Error(parameters, scale));
+      fflush(stdout);
+    }
+  }
+
+  const double error = tuner.Error(parameters, scale);
+  for (size_t j = 0; j < kNumParameters; j++) {
+    printf("%s = %ld (was %d)\n", kParameters[j].name, std::lround(parameters[j]),
+           kParameters[j].initial);
+  }
+  if (!WriteHeader(output, parameters, set.Size(), error)) {
+    std::cerr << "Cannot write " << output << std::endl;
+    return 1;
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  printf("Wrote %s in %.1f s\n", output.c_str(), elapsed.count());
+  return 0;
+}